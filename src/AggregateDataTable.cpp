@@ -0,0 +1,167 @@
+#include "AggregateDataTable.h"
+
+#include "stdlibs.h"
+#include "table.h"
+
+#include <algorithm>
+
+static int find_column(const std::vector<std::string>& column_names,
+                       const std::string& table_filepath,
+                       const std::string& column_name) {
+    auto iter =
+        std::find(column_names.begin(), column_names.end(), column_name);
+
+    if (iter == column_names.end()) {
+        dyntrace_log_error("aggregate column '%s' is not a column of '%s'",
+                           column_name.c_str(),
+                           table_filepath.c_str());
+    }
+
+    return iter - column_names.begin();
+}
+
+static double
+cell_to_double(const std::variant<bool, int, double, std::string>& cell) {
+    if (std::holds_alternative<int>(cell)) {
+        return std::get<int>(cell);
+    }
+
+    if (std::holds_alternative<double>(cell)) {
+        return std::get<double>(cell);
+    }
+
+    return 0;
+}
+
+AggregateDataTable::AggregateDataTable(
+    const std::string& table_filepath,
+    const std::vector<std::string>& column_names,
+    const std::vector<std::string>& key_column_names,
+    const std::vector<std::string>& timing_column_names,
+    int checkpoint_interval,
+    bool truncate,
+    bool binary,
+    int compression_level)
+    : column_count_(column_names.size())
+    , checkpoint_interval_(checkpoint_interval)
+    , row_count_(0)
+    , data_table_(nullptr) {
+    std::vector<std::string> aggregate_column_names;
+
+    for (const std::string& column_name: key_column_names) {
+        key_column_indices_.push_back(
+            find_column(column_names, table_filepath, column_name));
+        aggregate_column_names.push_back(column_name);
+    }
+
+    aggregate_column_names.push_back("count");
+
+    for (const std::string& column_name: timing_column_names) {
+        timing_column_indices_.push_back(
+            find_column(column_names, table_filepath, column_name));
+        aggregate_column_names.push_back(column_name + "_sum");
+        aggregate_column_names.push_back(column_name + "_min");
+        aggregate_column_names.push_back(column_name + "_max");
+    }
+
+    data_table_ = create_data_table(table_filepath,
+                                    aggregate_column_names,
+                                    truncate,
+                                    binary,
+                                    compression_level);
+}
+
+AggregateDataTable::~AggregateDataTable() {
+    checkpoint();
+    delete data_table_;
+}
+
+void AggregateDataTable::add_row_() {
+    if (row_.size() != column_count_) {
+        std::cerr << "number of columns in the row does not match number of "
+                  << "headings for file " << data_table_->get_filepath()
+                  << std::endl;
+        return;
+    }
+
+    /* cells are tagged by their type and strings by their length so that
+       distinct keys never have the same encoding */
+    key_.clear();
+
+    for (int index: key_column_indices_) {
+        const cell_t& cell = row_[index];
+        key_.push_back(static_cast<char>(cell.index()));
+
+        if (std::holds_alternative<std::string>(cell)) {
+            const std::string& value = std::get<std::string>(cell);
+            key_.append(std::to_string(value.size())).push_back(':');
+            key_.append(value);
+        } else if (std::holds_alternative<bool>(cell)) {
+            key_.push_back(std::get<bool>(cell));
+        } else if (std::holds_alternative<int>(cell)) {
+            int value = std::get<int>(cell);
+            key_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        } else {
+            double value = std::get<double>(cell);
+            key_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+    }
+
+    auto iter = aggregates_.find(key_);
+
+    if (iter == aggregates_.end()) {
+        aggregate_t aggregate;
+        aggregate.count = 0;
+        aggregate.sums.assign(timing_column_indices_.size(), 0);
+
+        for (int index: key_column_indices_) {
+            aggregate.key.push_back(row_[index]);
+        }
+
+        for (int index: timing_column_indices_) {
+            aggregate.minimums.push_back(cell_to_double(row_[index]));
+            aggregate.maximums.push_back(cell_to_double(row_[index]));
+        }
+
+        iter = aggregates_.insert({key_, std::move(aggregate)}).first;
+    }
+
+    aggregate_t& aggregate = iter->second;
+    ++aggregate.count;
+
+    for (std::size_t i = 0; i < timing_column_indices_.size(); ++i) {
+        double time = cell_to_double(row_[timing_column_indices_[i]]);
+        aggregate.sums[i] += time;
+        aggregate.minimums[i] = std::min(aggregate.minimums[i], time);
+        aggregate.maximums[i] = std::max(aggregate.maximums[i], time);
+    }
+
+    ++row_count_;
+
+    if (checkpoint_interval_ > 0 && row_count_ >= checkpoint_interval_) {
+        checkpoint();
+    }
+}
+
+void AggregateDataTable::checkpoint() {
+    for (const auto& binding: aggregates_) {
+        const aggregate_t& aggregate = binding.second;
+
+        for (const cell_t& cell: aggregate.key) {
+            std::visit(
+                [this](const auto& value) { data_table_->write_column(value); },
+                cell);
+        }
+
+        data_table_->write_column(static_cast<double>(aggregate.count));
+
+        for (std::size_t i = 0; i < aggregate.sums.size(); ++i) {
+            data_table_->write_column(aggregate.sums[i]);
+            data_table_->write_column(aggregate.minimums[i]);
+            data_table_->write_column(aggregate.maximums[i]);
+        }
+    }
+
+    aggregates_.clear();
+    row_count_ = 0;
+}
@@ -0,0 +1,87 @@
+#ifndef TYPETESTERDYNTRACER_AGGREGATE_DATA_TABLE_H
+#define TYPETESTERDYNTRACER_AGGREGATE_DATA_TABLE_H
+
+#include "DataTableStream.h"
+
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+/* key columns of the tables to aggregate, by table name */
+using aggregate_keys_t =
+    std::unordered_map<std::string, std::vector<std::string>>;
+
+/* A table whose rows are reduced by their key columns instead of being
+   written. Each distinct key is written once with the count of its rows and
+   the sum, minimum and maximum of each timing column; the other columns are
+   dropped. Rows are reduced in a hash table which is written and cleared
+   every checkpoint_interval rows, or only by checkpoint if the interval is
+   0. A key may thus appear once per checkpoint in the table. */
+class AggregateDataTable {
+  public:
+    AggregateDataTable(const std::string& table_filepath,
+                       const std::vector<std::string>& column_names,
+                       const std::vector<std::string>& key_column_names,
+                       const std::vector<std::string>& timing_column_names,
+                       int checkpoint_interval,
+                       bool truncate,
+                       bool binary,
+                       int compression_level);
+
+    AggregateDataTable(const AggregateDataTable&) = delete;
+
+    AggregateDataTable& operator=(const AggregateDataTable&) = delete;
+
+    ~AggregateDataTable();
+
+    template <typename... Args>
+    void write_row(Args... fields) {
+        row_.clear();
+        (add_cell_(fields), ...);
+        add_row_();
+    }
+
+    /* writes the aggregates of the rows since the last checkpoint */
+    void checkpoint();
+
+  private:
+    using cell_t = std::variant<bool, int, double, std::string>;
+
+    struct aggregate_t {
+        std::vector<cell_t> key;
+        unsigned long count;
+        std::vector<double> sums;
+        std::vector<double> minimums;
+        std::vector<double> maximums;
+    };
+
+    template <typename T>
+    void add_cell_(const T& value) {
+        if constexpr (std::is_same_v<T, bool>) {
+            row_.emplace_back(value);
+        } else if constexpr (std::is_integral_v<T> &&
+                             sizeof(T) <= sizeof(int)) {
+            row_.emplace_back(static_cast<int>(value));
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            row_.emplace_back(static_cast<double>(value));
+        } else {
+            row_.emplace_back(std::string(value));
+        }
+    }
+
+    void add_row_();
+
+    std::vector<int> key_column_indices_;
+    std::vector<int> timing_column_indices_;
+    const std::size_t column_count_;
+    const int checkpoint_interval_;
+    int row_count_;
+    std::vector<cell_t> row_;
+    std::string key_;
+    std::unordered_map<std::string, aggregate_t> aggregates_;
+    DataTableStream* data_table_;
+};
+
+#endif /* TYPETESTERDYNTRACER_AGGREGATE_DATA_TABLE_H */
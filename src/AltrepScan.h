@@ -0,0 +1,35 @@
+#ifndef TYPETESTERDYNTRACER_ALTREP_SCAN_H
+#define TYPETESTERDYNTRACER_ALTREP_SCAN_H
+
+#include <string>
+
+/* How an NA check of an ALTREP vector was answered */
+enum class AltrepScan {
+    NoNAHint = 0,
+    SortedHint,
+    DataPointer,
+    RegionScan,
+    ElementScan,
+    COUNT
+};
+
+inline std::string to_string(const AltrepScan altrep_scan) {
+    switch (altrep_scan) {
+    case AltrepScan::NoNAHint:
+        return "NoNAHint";
+    case AltrepScan::SortedHint:
+        return "SortedHint";
+    case AltrepScan::DataPointer:
+        return "DataPointer";
+    case AltrepScan::RegionScan:
+        return "RegionScan";
+    case AltrepScan::ElementScan:
+        return "ElementScan";
+    case AltrepScan::COUNT:
+        return "COUNT";
+    }
+
+    return "Undefined";
+}
+
+#endif /* TYPETESTERDYNTRACER_ALTREP_SCAN_H */
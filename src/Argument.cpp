@@ -5,31 +5,70 @@
 
 #include <tastr/ast/ast.hpp>
 
-Typecheck typecheck_inner(SEXP value, Argument* argument) {
+/* shape is set to the shape typecheck saturation is keyed on. Values
+   whose check only depends on their sexptype are keyed on it alone, the
+   missing argument and values without a denoted value have no shape.
+   Saturated checks are skipped. */
+Typecheck typecheck_inner(SEXP value,
+                          Argument* argument,
+                          int declaration_set,
+                          value_shape_t& shape) {
     Typecheck result;
 
     Function* function = argument->get_call()->get_function();
 
-    if (function->has_invalid_type_declaration()) {
+    if (function->has_invalid_type_declaration(declaration_set)) {
         result = Typecheck::NotAvailable;
         return result;
     }
 
-    const tastr::ast::TypeNode& type(function->get_parameter_type(
-        argument->get_formal_parameter_position()));
+    const TypecheckProgram& program(
+        function->get_typecheck_program(declaration_set));
+    int position = argument->get_formal_parameter_position();
+    const TypecheckSaturation& saturation =
+        function->get_typecheck_saturation(declaration_set, position);
+    int threshold = get_typecheck_budget().saturation_threshold;
 
-    if (argument->is_dot_dot_dot() && type.is_vararg_type_node()) {
+    DenotedValue* denoted_value = argument->get_denoted_value();
+    bool vararg =
+        argument->is_dot_dot_dot() && program.is_vararg_parameter(position);
+    sexptype_t sexptype = type_of_sexp(value);
+
+    /* the missing argument is a symbol, its checks are not saturated */
+    if (sexptype == MISSINGSXP) {
+        shape = UNDEFINED_VALUE_SHAPE;
+    } else if (vararg || program.is_shape_independent(value, position)) {
+        shape = get_sexptype_value_shape(TYPEOF(value));
+    } else if (denoted_value != nullptr) {
+        shape = denoted_value->get_value_shape(
+            value, program.get_parameter_na_sexptype_mask(position));
+    }
+
+    if (!saturation.should_check(shape, threshold)) {
+        result = Typecheck::Saturated;
+    } else if (vararg) {
         result = Typecheck::Match;
-    } else if (type_of_sexp(value) == MISSINGSXP) {
+    } else if (sexptype == MISSINGSXP) {
         result = Typecheck::Undefined;
-    } else if (type_of_sexp(value) != PROMSXP) {
-        result = satisfies(value, type);
+    } else if (sexptype != PROMSXP) {
+        if (is_sexptype_value_shape(shape) || denoted_value == nullptr) {
+            result = program.satisfies_parameter(value, position);
+        } else {
+            result = program.satisfies_parameter(
+                value, position, shape, denoted_value->get_value_shape_key());
+        }
     }
 
     return result;
 }
 
 void Argument::typecheck(SEXP value) {
+    Function* function = get_call()->get_function();
+    int set_count = function->get_type_declaration_set_count();
+
+    typecheck_results_.assign(set_count, Typecheck::Undefined);
+    typecheck_shapes_.assign(set_count, UNDEFINED_VALUE_SHAPE);
+
     outer_type_ = type_of_sexp(value);
 
     SEXP inner = value;
@@ -42,11 +81,49 @@ void Argument::typecheck(SEXP value) {
             inner = expr;
         } else {
             inner_type_ = type_of_sexp(expr);
-            typecheck_result_ = Typecheck::Undefined;
             return;
         }
     }
 
     inner_type_ = type_of_sexp(inner);
-    typecheck_result_ = typecheck_inner(inner, this);
+
+    for (int declaration_set = 0; declaration_set < set_count;
+         ++declaration_set) {
+        typecheck_results_[declaration_set] = typecheck_inner(
+            inner, this, declaration_set, typecheck_shapes_[declaration_set]);
+    }
+
+    if (inner_type_ == MISSINGSXP) {
+        return;
+    }
+
+    /* the profile and the shape are taken once. The NA flag of the shape
+       the value was typechecked with is reused, other values are only
+       scanned within the typecheck budget. */
+    bool na = false;
+    bool na_known = denoted_value_ != nullptr &&
+                    denoted_value_->find_value_shape_na(inner, na);
+
+    if (is_parameter_profiling_enabled() && !profiled_) {
+        ParameterProfile& profile =
+            function->get_parameter_profile(formal_parameter_position_);
+
+        if (na_known) {
+            profile.add(inner, na);
+        } else {
+            profile.add(inner);
+        }
+
+        profiled_ = true;
+    }
+
+    if (is_value_shape_capture_enabled() && !has_value_shape_) {
+        if (na_known) {
+            value_shape_ = ValueShape::capture(inner, na);
+        } else {
+            value_shape_ = ValueShape::capture(inner);
+        }
+
+        has_value_shape_ = true;
+    }
 }
@@ -2,6 +2,7 @@
 #define TYPETESTERDYNTRACER_ARGUMENT_H
 
 #include "DenotedValue.h"
+#include "ValueShape.h"
 #include "definitions.h"
 #include "sexptypes.h"
 #include "typechecker.h"
@@ -32,7 +33,10 @@ class Argument {
         , non_local_return_(false)
         , denoted_value_(nullptr)
         , forcing_actual_argument_position_(UNASSIGNED_ACTUAL_ARGUMENT_POSITION)
-        , typecheck_result_(Typecheck::Undefined)
+        , typecheck_results_()
+        , typecheck_shapes_()
+        , has_value_shape_(false)
+        , profiled_(false)
         , outer_type_(UNASSIGNEDSXP)
         , inner_type_(UNASSIGNEDSXP) {
     }
@@ -152,8 +156,19 @@ class Argument {
 
     void typecheck(SEXP value);
 
-    Typecheck get_typechecking_result() const {
-        return typecheck_result_;
+    /* Undefined until the argument is typechecked */
+    Typecheck get_typechecking_result(int declaration_set) const {
+        std::size_t index = declaration_set;
+        return index < typecheck_results_.size() ? typecheck_results_[index]
+                                                 : Typecheck::Undefined;
+    }
+
+    /* the shape typecheck saturation is keyed on, UNDEFINED_VALUE_SHAPE
+       until the argument is typechecked */
+    value_shape_t get_typechecking_shape(int declaration_set) const {
+        std::size_t index = declaration_set;
+        return index < typecheck_shapes_.size() ? typecheck_shapes_[index]
+                                                : UNDEFINED_VALUE_SHAPE;
     }
 
     sexptype_t get_outer_type() const {
@@ -164,6 +179,11 @@ class Argument {
         return inner_type_;
     }
 
+    /* nullptr unless value shapes are captured */
+    const ValueShape* get_value_shape() const {
+        return has_value_shape_ ? &value_shape_ : nullptr;
+    }
+
   private:
     Call* call_;
     const int formal_parameter_position_;
@@ -181,7 +201,13 @@ class Argument {
     bool non_local_return_;
     DenotedValue* denoted_value_;
     int forcing_actual_argument_position_;
-    Typecheck typecheck_result_;
+    /* one result per declaration set */
+    std::vector<Typecheck> typecheck_results_;
+    std::vector<value_shape_t> typecheck_shapes_;
+    bool has_value_shape_;
+    ValueShape value_shape_;
+    /* an argument is profiled once, even if it is typechecked again */
+    bool profiled_;
     sexptype_t typecheck_type_;
     sexptype_t outer_type_;
     sexptype_t inner_type_;
@@ -3,6 +3,7 @@
 
 #include "PromiseLifecycle.h"
 #include "sexptypes.h"
+#include "typechecker.h"
 #include "utilities.h"
 
 class Argument;
@@ -50,6 +51,40 @@ class DenotedValue {
         return id_;
     }
 
+    /* The shape is cached for the last value and NA mask it was computed
+       for, a forced promise is typechecked once for every argument it is
+       bound to. */
+    value_shape_t get_value_shape(SEXP value, std::uint32_t na_sexptype_mask) {
+        if (value != shape_value_ || TYPEOF(value) != shape_value_type_ ||
+            na_sexptype_mask != shape_na_sexptype_mask_) {
+            shape_value_ = value;
+            shape_value_type_ = TYPEOF(value);
+            shape_na_sexptype_mask_ = na_sexptype_mask;
+            value_shape_ =
+                compute_value_shape(value, na_sexptype_mask, value_shape_key_);
+        }
+        return value_shape_;
+    }
+
+    /* sets na to whether value has an NA if the shape last returned by
+       get_value_shape was computed for it and scanned it for NAs */
+    bool find_value_shape_na(SEXP value, bool& na) const {
+        if (value != shape_value_ || TYPEOF(value) != shape_value_type_ ||
+            value_shape_ == UNDEFINED_VALUE_SHAPE ||
+            !is_exact_value_shape(value_shape_) ||
+            !((shape_na_sexptype_mask_ >> TYPEOF(value)) & 1)) {
+            return false;
+        }
+
+        na = has_na_value_shape(value_shape_);
+        return true;
+    }
+
+    /* the key of the shape last returned by get_value_shape */
+    const std::string& get_value_shape_key() const {
+        return value_shape_key_;
+    }
+
     bool is_promise() const {
         return get_type() == PROMSXP;
     }
@@ -186,6 +221,14 @@ class DenotedValue {
         execution_time_ = execution_time;
     }
 
+    double get_corrected_execution_time() const {
+        return corrected_execution_time_;
+    }
+
+    void set_corrected_execution_time(double corrected_execution_time) {
+        corrected_execution_time_ = corrected_execution_time;
+    }
+
     void force();
 
     int get_force_count() const {
@@ -641,6 +684,7 @@ class DenotedValue {
         , non_local_return_(false)
         , creation_timestamp_(UNDEFINED_TIMESTAMP)
         , execution_time_(0.0)
+        , corrected_execution_time_(0.0)
         , escape_(false)
         , eval_depth_{UNASSIGNED_PROMISE_EVAL_DEPTH}
         , previous_call_id_(UNASSIGNED_CALL_ID)
@@ -695,7 +739,11 @@ class DenotedValue {
         , before_escape_indirect_non_lexical_scope_observation_count_(0)
         , indirect_non_lexical_scope_observation_count_(0)
         , creation_gc_cycle_(UNDEFINED_GC_CYCLE)
-        , destruction_gc_cycle_(UNDEFINED_GC_CYCLE) {
+        , destruction_gc_cycle_(UNDEFINED_GC_CYCLE)
+        , shape_value_(nullptr)
+        , shape_value_type_(NILSXP)
+        , shape_na_sexptype_mask_(0)
+        , value_shape_(UNDEFINED_VALUE_SHAPE) {
     }
 
     /* For a promise to escape:
@@ -810,6 +858,7 @@ class DenotedValue {
     bool non_local_return_;
     timestamp_t creation_timestamp_;
     double execution_time_;
+    double corrected_execution_time_;
     bool escape_;
     eval_depth_t eval_depth_;
     call_id_t previous_call_id_;
@@ -864,6 +913,11 @@ class DenotedValue {
     gc_cycle_t creation_gc_cycle_;
     gc_cycle_t destruction_gc_cycle_;
     PromiseLifecycle lifecycle_;
+    SEXP shape_value_;
+    SEXPTYPE shape_value_type_;
+    std::uint32_t shape_na_sexptype_mask_;
+    value_shape_t value_shape_;
+    std::string value_shape_key_;
 };
 
 #endif /* TYPETESTERDYNTRACER_DENOTED_VALUE_H */
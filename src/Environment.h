@@ -9,13 +9,68 @@ typedef int env_id_t;
 
 class Environment {
   public:
-    Environment(const SEXP rho, env_id_t id): rho_(rho), id_(id) {
+    Environment(const SEXP rho, env_id_t id)
+        : rho_(rho)
+        , id_(id)
+        , parent_(nullptr)
+        , parent_id_(-1)
+        , depth_(0)
+        , skip_(nullptr)
+        , skip_depth_(0)
+        , generation_(-1) {
     }
 
     env_id_t get_id() const {
         return id_;
     }
 
+    SEXP get_rho() const {
+        return rho_;
+    }
+
+    /* The ancestry fields below cache the ENCLOS chain of this environment.
+       depth is the number of ENCLOS links to R_NilValue and skip points to
+       the nearest strict ancestor whose depth is a multiple of
+       ENVIRONMENT_SKIP_DISTANCE. They are only valid if the generation
+       matches the generation of the tracer's environment table. */
+    SEXP get_parent() const {
+        return parent_;
+    }
+
+    env_id_t get_parent_id() const {
+        return parent_id_;
+    }
+
+    int get_depth() const {
+        return depth_;
+    }
+
+    SEXP get_skip() const {
+        return skip_;
+    }
+
+    int get_skip_depth() const {
+        return skip_depth_;
+    }
+
+    int get_generation() const {
+        return generation_;
+    }
+
+    void set_ancestry(SEXP parent,
+                      env_id_t parent_id,
+                      int depth,
+                      SEXP skip,
+                      int skip_depth,
+                      int generation) {
+        parent_ = parent;
+        parent_id_ = parent_id;
+        depth_ = depth;
+        skip_ = skip;
+        skip_depth_ = skip_depth;
+        generation_ = generation;
+    }
+
     Variable& lookup(const std::string& symbol) {
         auto iter = variable_mapping_.find(symbol);
         if (iter == variable_mapping_.end()) {
@@ -51,6 +106,12 @@ class Environment {
   private:
     const SEXP rho_;
     const env_id_t id_;
+    SEXP parent_;
+    env_id_t parent_id_;
+    int depth_;
+    SEXP skip_;
+    int skip_depth_;
+    int generation_;
 
     std::unordered_map<std::string, Variable> variable_mapping_;
 };
@@ -0,0 +1,74 @@
+#include "ExecutionClock.h"
+
+#include "stdlibs.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#    include <cpuid.h>
+#endif
+
+/* the interval the time stamp counter is timed over */
+static const long TSC_CALIBRATION_NANOSECONDS = 10000000;
+
+ClockMode clock_mode_from_string(const std::string& clock_mode) {
+    for (ClockMode mode: {ClockMode::Chrono,
+                          ClockMode::Tsc,
+                          ClockMode::Coarse,
+                          ClockMode::Off}) {
+        if (to_string(mode) == clock_mode) {
+            return mode;
+        }
+    }
+
+    dyntrace_log_error("unknown execution clock '%s'", clock_mode.c_str());
+    return ClockMode::Chrono;
+}
+
+ExecutionClock::ExecutionClock(ClockMode requested_mode)
+    : requested_mode_(requested_mode)
+    , mode_(requested_mode)
+    , nanoseconds_per_tick_(1) {
+    if (mode_ != ClockMode::Tsc) {
+        return;
+    }
+
+    if (has_invariant_tsc_()) {
+        calibrate_tsc_();
+    } else {
+        mode_ = ClockMode::Coarse;
+    }
+}
+
+/* an invariant time stamp counter ticks at a constant rate in all power
+   states, CPUID.80000007H:EDX[8] */
+bool ExecutionClock::has_invariant_tsc_() {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+
+    if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007) {
+        return false;
+    }
+
+    __cpuid(0x80000007, eax, ebx, ecx, edx);
+    return edx & (1 << 8);
+#else
+    return false;
+#endif
+}
+
+void ExecutionClock::calibrate_tsc_() {
+    struct timespec interval = {0, TSC_CALIBRATION_NANOSECONDS};
+
+    std::uint64_t start_time = read_clock_(CLOCK_MONOTONIC);
+    std::uint64_t start_ticks = read_tsc_();
+    nanosleep(&interval, nullptr);
+    std::uint64_t end_time = read_clock_(CLOCK_MONOTONIC);
+    std::uint64_t end_ticks = read_tsc_();
+
+    if (end_ticks <= start_ticks) {
+        mode_ = ClockMode::Coarse;
+        return;
+    }
+
+    nanoseconds_per_tick_ =
+        static_cast<double>(end_time - start_time) / (end_ticks - start_ticks);
+}
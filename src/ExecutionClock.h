@@ -0,0 +1,105 @@
+#ifndef TYPETESTERDYNTRACER_EXECUTION_CLOCK_H
+#define TYPETESTERDYNTRACER_EXECUTION_CLOCK_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#    include <x86intrin.h>
+#endif
+
+enum class ClockMode { Chrono, Tsc, Coarse, Off };
+
+inline std::string to_string(const ClockMode clock_mode) {
+    switch (clock_mode) {
+    case ClockMode::Chrono:
+        return "chrono";
+    case ClockMode::Tsc:
+        return "tsc";
+    case ClockMode::Coarse:
+        return "coarse";
+    case ClockMode::Off:
+        return "off";
+    }
+
+    return "Undefined";
+}
+
+ClockMode clock_mode_from_string(const std::string& clock_mode);
+
+/* The clock of the execution time accounting. chrono reads
+   high_resolution_clock, tsc reads the time stamp counter and converts it
+   with a rate calibrated against CLOCK_MONOTONIC when the clock is created,
+   coarse reads CLOCK_MONOTONIC_COARSE. tsc falls back to coarse if the
+   processor does not have an invariant time stamp counter. off disables the
+   accounting, execution times are then 0. */
+class ExecutionClock {
+  public:
+    explicit ExecutionClock(ClockMode requested_mode);
+
+    ClockMode get_requested_mode() const {
+        return requested_mode_;
+    }
+
+    ClockMode get_mode() const {
+        return mode_;
+    }
+
+    bool is_enabled() const {
+        return mode_ != ClockMode::Off;
+    }
+
+    double get_nanoseconds_per_tick() const {
+        return nanoseconds_per_tick_;
+    }
+
+    std::uint64_t read() const {
+        switch (mode_) {
+        case ClockMode::Tsc:
+            return read_tsc_();
+        case ClockMode::Coarse:
+            return read_clock_(CLOCK_MONOTONIC_COARSE);
+        case ClockMode::Chrono:
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::high_resolution_clock::now()
+                           .time_since_epoch())
+                .count();
+        case ClockMode::Off:
+            break;
+        }
+
+        return 0;
+    }
+
+    std::uint64_t to_nanoseconds(std::uint64_t ticks) const {
+        return mode_ == ClockMode::Tsc ? ticks * nanoseconds_per_tick_ : ticks;
+    }
+
+  private:
+    static std::uint64_t read_tsc_() {
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned int aux;
+        return __rdtscp(&aux);
+#else
+        return 0;
+#endif
+    }
+
+    static std::uint64_t read_clock_(clockid_t clock_id) {
+        struct timespec time;
+        clock_gettime(clock_id, &time);
+        return time.tv_sec * 1000000000ULL + time.tv_nsec;
+    }
+
+    static bool has_invariant_tsc_();
+
+    void calibrate_tsc_();
+
+    const ClockMode requested_mode_;
+    ClockMode mode_;
+    double nanoseconds_per_tick_;
+};
+
+#endif /* TYPETESTERDYNTRACER_EXECUTION_CLOCK_H */
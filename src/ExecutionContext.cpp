@@ -3,5 +3,10 @@
 #include "Function.h"
 
 ExecutionContext::ExecutionContext(Call* call)
-    : type_(call->get_function()->get_type()), call_(call), execution_time_(0) {
+    : type_(call->get_function()->get_type())
+    , call_(call)
+    , attached_r_context_(nullptr)
+    , attached_r_context_above_(false)
+    , execution_time_(0)
+    , probe_count_(0) {
 }
@@ -10,11 +10,21 @@ class Call;
 class ExecutionContext {
   public:
     explicit ExecutionContext(DenotedValue* promise_state)
-        : type_(PROMSXP), promise_state_(promise_state), execution_time_(0) {
+        : type_(PROMSXP)
+        , promise_state_(promise_state)
+        , attached_r_context_(nullptr)
+        , attached_r_context_above_(false)
+        , execution_time_(0)
+        , probe_count_(0) {
     }
 
     explicit ExecutionContext(const RCNTXT* r_context)
-        : type_(CONTEXTSXP), r_context_(r_context), execution_time_(0) {
+        : type_(CONTEXTSXP)
+        , r_context_(r_context)
+        , attached_r_context_(nullptr)
+        , attached_r_context_above_(false)
+        , execution_time_(0)
+        , probe_count_(0) {
     }
 
     /* defined in cpp file to get around cyclic dependency issues. */
@@ -68,6 +78,31 @@ class ExecutionContext {
         return r_context_;
     }
 
+    /* The R context created for a closure call is attached to the call
+       entry instead of occupying an entry of its own. above is true if the
+       context was entered after the call. */
+    void attach_r_context(const RCNTXT* r_context, bool above) {
+        attached_r_context_ = r_context;
+        attached_r_context_above_ = above;
+    }
+
+    void detach_r_context() {
+        attached_r_context_ = nullptr;
+        attached_r_context_above_ = false;
+    }
+
+    const RCNTXT* get_attached_r_context() const {
+        return attached_r_context_;
+    }
+
+    bool has_attached_r_context() const {
+        return attached_r_context_ != nullptr;
+    }
+
+    bool is_attached_r_context_above() const {
+        return attached_r_context_above_;
+    }
+
     void increment_execution_time(const std::uint64_t increment) {
         execution_time_ += increment;
     }
@@ -76,6 +111,16 @@ class ExecutionContext {
         return execution_time_;
     }
 
+    /* the number of probes that paused the execution timer while the
+       context, or a context it contains, was running */
+    void increment_probe_count(const std::uint64_t increment) {
+        probe_count_ += increment;
+    }
+
+    std::uint64_t get_probe_count() const {
+        return probe_count_;
+    }
+
   private:
     sexptype_t type_;
     union {
@@ -83,7 +128,10 @@ class ExecutionContext {
         Call* call_;
         const RCNTXT* r_context_;
     };
+    const RCNTXT* attached_r_context_;
+    bool attached_r_context_above_;
     std::uint64_t execution_time_;
+    std::uint64_t probe_count_;
 };
 
 using execution_contexts_t = std::vector<ExecutionContext>;
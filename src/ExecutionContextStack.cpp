@@ -0,0 +1,114 @@
+#include "ExecutionContextStack.h"
+
+#include "Function.h"
+
+/* R creates a function context for every closure call, its cloenv is the
+   environment of the call. */
+static bool is_closure_r_context(const RCNTXT* r_context, SEXP environment) {
+    return (r_context->callflag & CTXT_FUNCTION) &&
+           r_context->cloenv == environment;
+}
+
+void ExecutionContextStack::push(Call* call) {
+    ExecutionContext context(call);
+
+    if (context.is_closure() && !is_empty()) {
+        const ExecutionContext& top = stack_.back();
+
+        if (top.is_r_context() &&
+            is_closure_r_context(top.get_r_context(),
+                                 call->get_environment())) {
+            context.attach_r_context(top.get_r_context(), false);
+            context.increment_execution_time(top.get_execution_time());
+            context.increment_probe_count(top.get_probe_count());
+            pop_();
+        }
+    }
+
+    push_(context);
+}
+
+void ExecutionContextStack::push(const RCNTXT* r_context) {
+    if (!is_empty()) {
+        ExecutionContext& top = stack_.back();
+
+        if (top.is_closure() && !top.has_attached_r_context() &&
+            is_closure_r_context(r_context,
+                                 top.get_closure()->get_environment())) {
+            top.attach_r_context(r_context, true);
+            return;
+        }
+    }
+
+    push_(ExecutionContext(r_context));
+}
+
+int ExecutionContextStack::find_closure_index(const Call* call) const {
+    int index = find_closure_index(call->get_environment());
+
+    while (index != -1 && stack_[index].get_call() != call) {
+        index = aggregates_[index].same_environment_closure_index;
+    }
+
+    return index;
+}
+
+void ExecutionContextStack::push_aggregate_() {
+    const int index = stack_.size() - 1;
+    const ExecutionContext& context = stack_.back();
+
+    context_aggregate_t aggregate = {-1, -1, -1, -1, 0, 0, -1};
+
+    if (!aggregates_.empty()) {
+        aggregate = aggregates_.back();
+        aggregate.same_environment_closure_index = -1;
+    }
+
+    if (context.is_call()) {
+        aggregate.non_r_context_index = index;
+
+        if (!context.get_call()->get_function()->is_curly_bracket()) {
+            aggregate.non_curly_call_index = index;
+        }
+    }
+
+    if (context.is_closure()) {
+        SEXP environment = context.get_closure()->get_environment();
+        auto iter = closure_environment_index_.find(environment);
+
+        if (iter == closure_environment_index_.end()) {
+            closure_environment_index_.insert({environment, index});
+        } else {
+            aggregate.same_environment_closure_index = iter->second;
+            iter->second = index;
+        }
+
+        aggregate.closure_index = index;
+        ++aggregate.closure_count;
+    }
+
+    if (context.is_promise()) {
+        aggregate.non_r_context_index = index;
+        aggregate.promise_index = index;
+        ++aggregate.promise_count;
+    }
+
+    aggregates_.push_back(aggregate);
+}
+
+void ExecutionContextStack::pop_aggregate_() {
+    const ExecutionContext& context = stack_.back();
+
+    if (context.is_closure()) {
+        SEXP environment = context.get_closure()->get_environment();
+        int previous = aggregates_.back().same_environment_closure_index;
+
+        if (previous == -1) {
+            closure_environment_index_.erase(environment);
+        } else {
+            closure_environment_index_[environment] = previous;
+        }
+    }
+
+    aggregates_.pop_back();
+}
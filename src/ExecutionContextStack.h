@@ -3,10 +3,27 @@
 
 #include "ExecutionContext.h"
 
+#include <unordered_map>
 #include <vector>
 
 using execution_contexts_t = std::vector<ExecutionContext>;
 
+/* Prefix aggregates carried by each stack entry. They summarize the entry
+   and everything below it so that the common reverse stack queries can be
+   answered without walking the stack. Indices are -1 when no such entry
+   exists. */
+struct context_aggregate_t {
+    int closure_index;
+    int non_curly_call_index;
+    int non_r_context_index;
+    int promise_index;
+    int closure_count;
+    int promise_count;
+    /* index of the next closure below this one with the same environment,
+       only meaningful for closure entries. */
+    int same_environment_closure_index;
+};
+
 class ExecutionContextStack {
   public:
     using iterator = execution_contexts_t::iterator;
@@ -57,14 +74,35 @@ class ExecutionContextStack {
         return stack_.crend();
     }
 
-    template <typename T>
-    void push(T* context) {
-        stack_.push_back(ExecutionContext(context));
+    void push(DenotedValue* promise) {
+        push_(ExecutionContext(promise));
     }
 
+    /* defined in cpp file to get around cyclic dependency issues. */
+    void push(Call* call);
+
+    void push(const RCNTXT* r_context);
+
     ExecutionContext pop() {
         ExecutionContext context{peek(1)};
-        stack_.pop_back();
+
+        if (!context.has_attached_r_context()) {
+            pop_();
+            return context;
+        }
+
+        /* a context entered after its call exits before the call */
+        if (context.is_attached_r_context_above()) {
+            const RCNTXT* r_context = context.get_attached_r_context();
+            stack_.back().detach_r_context();
+            return ExecutionContext(r_context);
+        }
+
+        /* a call exits before the context entered for it, which stays on
+           the stack on its own until it is exited. */
+        pop_();
+        push_(ExecutionContext(context.get_attached_r_context()));
+        context.detach_r_context();
         return context;
     }
 
@@ -76,24 +114,139 @@ class ExecutionContextStack {
         return stack_.at(stack_.size() - n);
     }
 
-    execution_contexts_t unwind(const ExecutionContext& context) {
-        execution_contexts_t unwound_contexts;
+    const ExecutionContext& at(int index) const {
+        return stack_[index];
+    }
+
+    ExecutionContext& at(int index) {
+        return stack_[index];
+    }
+
+    /* Pops entries up to the R context being jumped to and returns them in
+       the order in which they were popped. Attached R contexts are reported
+       as entries of their own, in the position they would occupy had they
+       been pushed separately. The returned buffer is reused by the next
+       unwind. */
+    const execution_contexts_t& unwind(const RCNTXT* r_context) {
+        unwound_contexts_.clear();
 
         while (size() > 0) {
-            ExecutionContext& temp_context{stack_.back()};
+            ExecutionContext temp_context{stack_.back()};
 
             if (temp_context.is_r_context() &&
-                (temp_context.get_r_context() == context.get_r_context())) {
-                return unwound_contexts;
+                (temp_context.get_r_context() == r_context)) {
+                return unwound_contexts_;
+            }
+
+            if (!temp_context.has_attached_r_context()) {
+                pop_();
+                unwound_contexts_.push_back(temp_context);
+                continue;
+            }
+
+            const RCNTXT* attached = temp_context.get_attached_r_context();
+            bool above = temp_context.is_attached_r_context_above();
+
+            if (attached == r_context && above) {
+                return unwound_contexts_;
+            }
+
+            pop_();
+
+            temp_context.detach_r_context();
+
+            if (above) {
+                unwound_contexts_.push_back(ExecutionContext(attached));
+            }
+
+            unwound_contexts_.push_back(temp_context);
+
+            if (attached == r_context) {
+                push_(ExecutionContext(attached));
+                return unwound_contexts_;
+            }
+
+            if (!above) {
+                unwound_contexts_.push_back(ExecutionContext(attached));
             }
-            stack_.pop_back();
-            unwound_contexts.push_back(temp_context);
         }
         dyntrace_log_error("cannot find matching context while unwinding\n");
     }
 
+    /* index of the topmost closure, -1 if there is none */
+    int get_closure_index() const {
+        return is_empty() ? -1 : aggregates_.back().closure_index;
+    }
+
+    /* index of the topmost call whose function is not '{' */
+    int get_non_curly_call_index() const {
+        return is_empty() ? -1 : aggregates_.back().non_curly_call_index;
+    }
+
+    /* index of the topmost call or promise */
+    int get_non_r_context_index() const {
+        return is_empty() ? -1 : aggregates_.back().non_r_context_index;
+    }
+
+    /* number of promises being forced */
+    int get_promise_count() const {
+        return is_empty() ? 0 : aggregates_.back().promise_count;
+    }
+
+    bool has_active_promise() const {
+        return get_promise_count() != 0;
+    }
+
+    /* index of the topmost promise, -1 if no promise is being forced */
+    int get_promise_index() const {
+        return is_empty() ? -1 : aggregates_.back().promise_index;
+    }
+
+    /* index of the topmost promise at or below index */
+    int get_promise_index(int index) const {
+        return index < 0 ? -1 : aggregates_[index].promise_index;
+    }
+
+    /* number of closures strictly above index */
+    int get_closure_count_above(int index) const {
+        return aggregates_.back().closure_count -
+               aggregates_[index].closure_count;
+    }
+
+    /* number of promises strictly above index */
+    int get_promise_count_above(int index) const {
+        return aggregates_.back().promise_count -
+               aggregates_[index].promise_count;
+    }
+
+    /* index of the topmost closure with the given environment */
+    int find_closure_index(SEXP environment) const {
+        auto iter = closure_environment_index_.find(environment);
+        return iter == closure_environment_index_.end() ? -1 : iter->second;
+    }
+
+    /* index of the closure entry for call, -1 if call is not on the stack */
+    int find_closure_index(const Call* call) const;
+
   private:
+    void push_(const ExecutionContext& context) {
+        stack_.push_back(context);
+        push_aggregate_();
+    }
+
+    void pop_() {
+        pop_aggregate_();
+        stack_.pop_back();
+    }
+
+    /* defined in cpp file to get around cyclic dependency issues. */
+    void push_aggregate_();
+    void pop_aggregate_();
+
     execution_contexts_t stack_;
+    execution_contexts_t unwound_contexts_;
+    std::vector<context_aggregate_t> aggregates_;
+    std::unordered_map<SEXP, int> closure_environment_index_;
 };
 
 #endif /* TYPETESTERDYNTRACER_EXECUTION_CONTEXT_STACK_H */
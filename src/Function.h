@@ -3,14 +3,22 @@
 
 #include "Call.h"
 #include "CallSummary.h"
+#include "InferredSignature.h"
+#include "ParameterProfile.h"
 #include "Rinternals.h"
 #include "SubstituteClass.h"
 #include "SubstituteSummary.h"
+#include "TypecheckProgram.h"
+#include "TypecheckSaturation.h"
 #include "sexptypes.h"
 #include "utilities.h"
 
+#include <algorithm>
 #include <fstream>
-#include <tastr/ast/ast.hpp>
+#include <map>
+
+/* one program per declaration set, nullptr if the set has no declaration */
+using type_declarations_t = std::vector<const TypecheckProgram*>;
 
 class Function {
   public:
@@ -23,7 +31,12 @@ class Function {
         , namespace_(package_name)
         , definition_(definition)
         , id_(id)
-        , type_declaration_(nullptr) {
+        , type_declaration_generation_(-1)
+        , type_declaration_symbol_(nullptr)
+        , probe_count_(0)
+        , tracer_time_(0)
+        , program_time_(0)
+        , rewires_environments_(false) {
         type_ = type_of_sexp(op);
 
         if (type_ == CLOSXP) {
@@ -163,6 +176,14 @@ class Function {
         return wrapper_;
     }
 
+    /* true if this function is known by a name that changes the ENCLOS
+       link of existing environments. Rewires from C, such as SET_ENCLOS in
+       rlang::env_poke_parent, are not recognized by name, the cached
+       ancestry checks the links it follows instead. */
+    bool rewires_environments() const {
+        return rewires_environments_;
+    }
+
     void add_summary(Call* call) {
         int i;
 
@@ -176,6 +197,8 @@ class Function {
 
         if (i == names_.size()) {
             names_.push_back(call->get_function_name());
+            rewires_environments_ = rewires_environments_ ||
+                                    is_environment_rewiring_name_(names_.back());
         }
 
         for (i = 0; i < call_summaries_.size(); ++i) {
@@ -211,32 +234,175 @@ class Function {
     static std::tuple<std::string, std::string, function_id_t>
     compute_definition_and_id(const SEXP op);
 
-    void set_type_declaration(tastr::ast::FunctionTypeNode* type_declaration) {
-        type_declaration_ = type_declaration;
+    std::size_t get_type_declaration_set_count() const {
+        return typecheck_programs_.size();
+    }
+
+    /* the program is owned by the type declaration cache of its set */
+    void set_type_declaration(int declaration_set,
+                              const TypecheckProgram* typecheck_program) {
+        typecheck_programs_[declaration_set] = typecheck_program;
+    }
+
+    bool has_valid_type_declaration(int declaration_set) const {
+        return !has_invalid_type_declaration(declaration_set);
     }
 
-    const tastr::ast::FunctionTypeNode& get_type_declaration() const {
-        return *type_declaration_;
+    bool has_invalid_type_declaration(int declaration_set) const {
+        return typecheck_programs_[declaration_set] == nullptr;
     }
 
-    bool has_valid_type_declaration() const {
-        return !has_invalid_type_declaration();
+    /* true if every declaration set has a declaration */
+    bool has_valid_type_declarations() const {
+        return std::find(typecheck_programs_.begin(),
+                         typecheck_programs_.end(),
+                         nullptr) == typecheck_programs_.end();
     }
 
-    bool has_invalid_type_declaration() const {
-        return type_declaration_ == nullptr;
+    const TypecheckProgram& get_typecheck_program(int declaration_set) const {
+        return *typecheck_programs_[declaration_set];
     }
 
-    const tastr::ast::TypeNode&
-    get_parameter_type(int formal_parameter_position) const {
-        return *get_type_declaration()
-                    .get_parameter_types()
-                    .at(formal_parameter_position)
-                    .get();
+    /* Declarations are looked up by the symbols the function is called
+       by. The outcome of each lookup, including the absence of a
+       declaration, is remembered for the generation of the type
+       declarations it was made in. Symbols are never collected, so they
+       identify names without comparing strings. Calls by other expressions,
+       such as pkg::f or obj$f, have the symbol R_NilValue and are
+       remembered by the name computed for the call instead. */
+    int get_type_declaration_generation() const {
+        return type_declaration_generation_;
     }
 
-    const tastr::ast::TypeNode& get_return_type() const {
-        return get_type_declaration().get_return_type();
+    /* true if the declarations were resolved for the symbol the function
+       was last called by in this generation */
+    bool is_type_declaration_resolved(int generation, SEXP symbol) const {
+        return symbol != R_NilValue &&
+               type_declaration_generation_ == generation &&
+               type_declaration_symbol_ == symbol;
+    }
+
+    void set_type_declaration_resolved(SEXP symbol) {
+        type_declaration_symbol_ = symbol;
+    }
+
+    /* saturation is dropped with the programs it was reached for */
+    void reset_type_declarations(int generation, std::size_t set_count) {
+        type_declaration_generation_ = generation;
+        type_declaration_symbol_ = nullptr;
+        typecheck_programs_.assign(set_count, nullptr);
+        type_declaration_lookups_.clear();
+        type_declaration_name_lookups_.clear();
+        typecheck_saturations_.clear();
+    }
+
+    const type_declarations_t*
+    find_type_declarations(SEXP symbol, const std::string& name) const {
+        if (symbol == R_NilValue) {
+            auto iter = type_declaration_name_lookups_.find(name);
+            return iter == type_declaration_name_lookups_.end()
+                       ? nullptr
+                       : &iter->second;
+        }
+
+        auto iter = type_declaration_lookups_.find(symbol);
+        return iter == type_declaration_lookups_.end() ? nullptr
+                                                       : &iter->second;
+    }
+
+    const type_declarations_t&
+    add_type_declarations(SEXP symbol,
+                          const std::string& name,
+                          const type_declarations_t& programs) {
+        if (symbol == R_NilValue) {
+            return type_declaration_name_lookups_.insert({name, programs})
+                .first->second;
+        }
+
+        return type_declaration_lookups_.insert({symbol, programs})
+            .first->second;
+    }
+
+    /* the return value has position -1 */
+    TypecheckSaturation&
+    get_typecheck_saturation(int declaration_set,
+                             int formal_parameter_position) {
+        std::size_t set_index = declaration_set;
+
+        if (set_index >= typecheck_saturations_.size()) {
+            typecheck_saturations_.resize(set_index + 1);
+        }
+
+        std::vector<TypecheckSaturation>& saturations =
+            typecheck_saturations_[set_index];
+        std::size_t index = formal_parameter_position + 1;
+
+        if (index >= saturations.size()) {
+            saturations.resize(index + 1);
+        }
+
+        return saturations[index];
+    }
+
+    void add_skipped_typecheck(int declaration_set,
+                               int formal_parameter_position,
+                               value_shape_t shape) {
+        get_typecheck_saturation(declaration_set, formal_parameter_position)
+            .skip();
+        ++skipped_typechecks_[{
+            declaration_set, formal_parameter_position, shape}];
+    }
+
+    const std::map<skipped_typecheck_t, unsigned long>&
+    get_skipped_typechecks() const {
+        return skipped_typechecks_;
+    }
+
+    /* the return value has position -1 */
+    ParameterProfile& get_parameter_profile(int formal_parameter_position) {
+        std::size_t index = formal_parameter_position + 1;
+        if (index >= parameter_profiles_.size()) {
+            parameter_profiles_.resize(index + 1);
+        }
+        return parameter_profiles_[index];
+    }
+
+    /* indexed by formal parameter position plus one */
+    const std::vector<ParameterProfile>& get_parameter_profiles() const {
+        return parameter_profiles_;
+    }
+
+    InferredSignature& get_inferred_signature() {
+        return inferred_signature_;
+    }
+
+    const InferredSignature& get_inferred_signature() const {
+        return inferred_signature_;
+    }
+
+    /* time spent in probes while a call of the function was the innermost
+       closure call when the probe returned */
+    void add_tracer_time(std::uint64_t tracer_time) {
+        ++probe_count_;
+        tracer_time_ += tracer_time;
+    }
+
+    /* time spent in the program while a call of the function was the
+       innermost closure call */
+    void add_program_time(std::uint64_t program_time) {
+        program_time_ += program_time;
+    }
+
+    std::uint64_t get_probe_count() const {
+        return probe_count_;
+    }
+
+    std::uint64_t get_tracer_time() const {
+        return tracer_time_;
+    }
+
+    std::uint64_t get_program_time() const {
+        return program_time_;
     }
 
   private:
@@ -248,12 +414,30 @@ class Function {
     function_id_t id_;
     int primitive_offset_;
     bool byte_compiled_;
-    tastr::ast::FunctionTypeNode* type_declaration_;
+    type_declarations_t typecheck_programs_;
+    int type_declaration_generation_;
+    SEXP type_declaration_symbol_;
+    std::unordered_map<SEXP, type_declarations_t> type_declaration_lookups_;
+    std::unordered_map<std::string, type_declarations_t>
+        type_declaration_name_lookups_;
+    std::vector<std::vector<TypecheckSaturation>> typecheck_saturations_;
+    std::map<skipped_typecheck_t, unsigned long> skipped_typechecks_;
+    InferredSignature inferred_signature_;
+    std::vector<ParameterProfile> parameter_profiles_;
+    std::uint64_t probe_count_;
+    std::uint64_t tracer_time_;
+    std::uint64_t program_time_;
 
     std::vector<std::string> names_;
     std::vector<CallSummary> call_summaries_;
     std::vector<SubstituteSummary> substitute_summaries_;
 
+    bool rewires_environments_;
+
+    static bool is_environment_rewiring_name_(const std::string& name) {
+        return name == "parent.env<-" || name == "attach" || name == "detach";
+    }
+
     static const int PRIMITIVE_RETURN_OFFSET_ = 6;
     static const int PRIMITIVE_CURLY_BRACKET_OFFSET_ = 11;
     static const int PRIMITIVE_DOT_INTERNAL_OFFSET_ = 26;
@@ -0,0 +1,238 @@
+#include "InferredSignature.h"
+
+#include "constants.h"
+
+#include <algorithm>
+#include <cctype>
+
+static const std::uint8_t SCALAR_SEEN = 1;
+static const std::uint8_t VECTOR_SEEN = 2;
+static const std::uint8_t NA_SEEN = 4;
+
+static std::uint32_t sexptype_bit(SEXPTYPE sexptype) {
+    return static_cast<std::uint32_t>(1) << sexptype;
+}
+
+static const std::pair<SEXPTYPE, const char*> atomic_type_names[] = {
+    {LGLSXP, "lgl"},
+    {INTSXP, "int"},
+    {REALSXP, "dbl"},
+    {CPLXSXP, "clx"},
+    {STRSXP, "chr"},
+    {RAWSXP, "raw"}};
+
+static const std::pair<SEXPTYPE, const char*> other_type_names[] = {
+    {S4SXP, "s4"},
+    {SYMSXP, "symbol"},
+    {LISTSXP, "pairlist"},
+    {ENVSXP, "environment"},
+    {LANGSXP, "language"},
+    {EXPRSXP, "expression"},
+    {EXTPTRSXP, "externalptr"},
+    {BCODESXP, "bytecode"},
+    {WEAKREFSXP, "weakref"}};
+
+static std::string join(const std::vector<std::string>& strings,
+                        const std::string& separator) {
+    std::string result;
+
+    for (std::size_t i = 0; i < strings.size(); ++i) {
+        if (i != 0) {
+            result.append(separator);
+        }
+        result.append(strings[i]);
+    }
+
+    return result;
+}
+
+static std::string tag_to_string(const std::string& tag) {
+    bool syntactic = !tag.empty() && (isalpha(tag[0]) || tag[0] == '.');
+
+    for (std::size_t i = 1; syntactic && i < tag.size(); ++i) {
+        syntactic = isalnum(tag[i]) || tag[i] == '.' || tag[i] == '_';
+    }
+
+    return syntactic ? tag : "`" + tag + "`";
+}
+
+void InferredType::widen_() {
+    widened_ = true;
+    sexptype_mask_ = 0;
+    std::vector<aggregate_t>().swap(aggregates_);
+}
+
+void InferredType::add_(const ValueShape& shape, int depth) {
+    if (widened_) {
+        return;
+    }
+
+    SEXPTYPE sexptype = shape.get_sexptype();
+
+    for (const auto& atomic_type: atomic_type_names) {
+        if (atomic_type.first == sexptype) {
+            sexptype_mask_ |= sexptype_bit(sexptype);
+            atomic_flags_[sexptype] |=
+                (shape.is_scalar() ? SCALAR_SEEN : VECTOR_SEEN) |
+                (shape.has_na() ? NA_SEEN : 0);
+            return;
+        }
+    }
+
+    if (sexptype != VECSXP) {
+        sexptype_mask_ |= sexptype_bit(sexptype);
+    } else if (depth >= INFERRED_TYPE_DEPTH) {
+        widen_();
+    } else {
+        add_aggregate_(shape, depth);
+    }
+}
+
+void InferredType::add_aggregate_(const ValueShape& shape, int depth) {
+    std::size_t length = shape.get_length();
+    const std::vector<std::string>& names = shape.get_names();
+    const std::vector<ValueShape>& elements = shape.get_elements();
+
+    /* elements of the shape were not all captured */
+    if (length > INFERRED_TYPE_ELEMENT_LIMIT || elements.size() != length ||
+        (shape.has_names() && names.size() != length)) {
+        widen_();
+        return;
+    }
+
+    aggregate_t* aggregate = nullptr;
+
+    for (aggregate_t& candidate: aggregates_) {
+        if (candidate.is_struct == shape.has_names() &&
+            candidate.elements.size() == length && candidate.tags == names) {
+            aggregate = &candidate;
+            break;
+        }
+    }
+
+    if (aggregate == nullptr) {
+        if (aggregates_.size() >= INFERRED_TYPE_AGGREGATE_LIMIT) {
+            widen_();
+            return;
+        }
+
+        aggregates_.push_back(aggregate_t{
+            shape.has_names(), names, std::vector<InferredType>(length)});
+        aggregate = &aggregates_.back();
+    }
+
+    for (std::size_t i = 0; i < length; ++i) {
+        aggregate->elements[i].add_(elements[i], depth + 1);
+    }
+
+    sexptype_mask_ |= sexptype_bit(VECSXP);
+}
+
+std::string InferredType::to_string() const {
+    if (widened_ || is_empty()) {
+        return "any";
+    }
+
+    std::vector<std::string> alternatives;
+
+    for (const auto& atomic_type: atomic_type_names) {
+        std::uint8_t flags = atomic_flags_[atomic_type.first];
+
+        if (flags != 0) {
+            alternatives.push_back(std::string(flags & NA_SEEN ? "^" : "") +
+                                   atomic_type.second +
+                                   (flags & VECTOR_SEEN ? "[]" : ""));
+        }
+    }
+
+    std::uint32_t named_mask = sexptype_bit(NILSXP) | sexptype_bit(VECSXP);
+
+    for (const auto& atomic_type: atomic_type_names) {
+        named_mask |= sexptype_bit(atomic_type.first);
+    }
+
+    for (const auto& other_type: other_type_names) {
+        named_mask |= sexptype_bit(other_type.first);
+
+        if (sexptype_mask_ & sexptype_bit(other_type.first)) {
+            alternatives.push_back(other_type.second);
+        }
+    }
+
+    /* functions and other values have no type of their own */
+    if (sexptype_mask_ & ~named_mask) {
+        return "any";
+    }
+
+    for (const aggregate_t& aggregate: aggregates_) {
+        std::vector<std::string> elements;
+
+        for (std::size_t i = 0; i < aggregate.elements.size(); ++i) {
+            std::string element = aggregate.elements[i].to_string();
+
+            if (aggregate.is_struct) {
+                element = tag_to_string(aggregate.tags[i]) + ": " + element;
+            }
+
+            elements.push_back(element);
+        }
+
+        alternatives.push_back((aggregate.is_struct ? "struct<" : "list<") +
+                               join(elements, ", ") + ">");
+    }
+
+    if (!(sexptype_mask_ & sexptype_bit(NILSXP))) {
+        return join(alternatives, " | ");
+    }
+
+    if (alternatives.empty()) {
+        return "null";
+    }
+
+    if (alternatives.size() == 1) {
+        return "? " + alternatives.front();
+    }
+
+    return "? (" + join(alternatives, " | ") + ")";
+}
+
+void InferredSignature::add_parameter(int formal_parameter_position,
+                                      bool dot_dot_dot,
+                                      const ValueShape& shape) {
+    if (formal_parameter_position < 0) {
+        return;
+    }
+
+    std::size_t index = formal_parameter_position;
+
+    if (index >= parameter_types_.size()) {
+        parameter_types_.resize(index + 1);
+        parameter_varargs_.resize(index + 1, false);
+    }
+
+    /* the values of a vararg do not contribute to its type */
+    if (dot_dot_dot) {
+        parameter_varargs_[index] = true;
+    } else {
+        parameter_types_[index].add(shape);
+    }
+}
+
+std::string
+InferredSignature::to_string(std::size_t formal_parameter_count) const {
+    std::vector<std::string> parameters;
+    std::size_t count = std::max(formal_parameter_count,
+                                 parameter_types_.size());
+
+    for (std::size_t i = 0; i < count; ++i) {
+        if (i < parameter_varargs_.size() && parameter_varargs_[i]) {
+            parameters.push_back("...");
+        } else if (i < parameter_types_.size()) {
+            parameters.push_back(parameter_types_[i].to_string());
+        } else {
+            parameters.push_back("any");
+        }
+    }
+
+    return "<" + join(parameters, ", ") + "> => " + return_type_.to_string();
+}
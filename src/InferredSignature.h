@@ -0,0 +1,84 @@
+#ifndef TYPETESTERDYNTRACER_INFERRED_SIGNATURE_H
+#define TYPETESTERDYNTRACER_INFERRED_SIGNATURE_H
+
+#include "ValueShape.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* The join of the shapes of the values seen by a parameter or return
+   value. Atomic vectors are tracked per sexptype as scalar or vector, with
+   or without NA, other sexptypes by their presence and lists as list or
+   struct alternatives whose elements are inferred types themselves. At most
+   INFERRED_TYPE_AGGREGATE_LIMIT alternatives of up to
+   INFERRED_TYPE_ELEMENT_LIMIT elements are kept, nested in fewer than
+   INFERRED_TYPE_DEPTH lists. A type exceeding these limits is widened to
+   any, which bounds the memory of each type. */
+class InferredType {
+  public:
+    InferredType(): widened_(false), sexptype_mask_(0), atomic_flags_{0} {
+    }
+
+    bool is_empty() const {
+        return !widened_ && sexptype_mask_ == 0 && aggregates_.empty();
+    }
+
+    void add(const ValueShape& shape) {
+        add_(shape, 0);
+    }
+
+    /* the type in tastr syntax, any if no value was seen */
+    std::string to_string() const;
+
+  private:
+    struct aggregate_t {
+        bool is_struct;
+        std::vector<std::string> tags;
+        std::vector<InferredType> elements;
+    };
+
+    void add_(const ValueShape& shape, int depth);
+
+    void add_aggregate_(const ValueShape& shape, int depth);
+
+    void widen_();
+
+    bool widened_;
+    std::uint32_t sexptype_mask_;
+    std::uint8_t atomic_flags_[32];
+    std::vector<aggregate_t> aggregates_;
+};
+
+/* Inferred types of the parameters and return value of a function. A
+   parameter that received arguments through dot dot dot is inferred as a
+   vararg. */
+class InferredSignature {
+  public:
+    InferredSignature(): observation_count_(0) {
+    }
+
+    unsigned long get_observation_count() const {
+        return observation_count_;
+    }
+
+    void add_parameter(int formal_parameter_position,
+                       bool dot_dot_dot,
+                       const ValueShape& shape);
+
+    void add_return(const ValueShape& shape) {
+        ++observation_count_;
+        return_type_.add(shape);
+    }
+
+    /* the signature in tastr syntax, <T1, T2> => R */
+    std::string to_string(std::size_t formal_parameter_count) const;
+
+  private:
+    unsigned long observation_count_;
+    std::vector<InferredType> parameter_types_;
+    std::vector<bool> parameter_varargs_;
+    InferredType return_type_;
+};
+
+#endif /* TYPETESTERDYNTRACER_INFERRED_SIGNATURE_H */
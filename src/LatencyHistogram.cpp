@@ -0,0 +1,35 @@
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+std::uint64_t LatencyHistogram::get_bucket_upper_bound_(int bucket) {
+    if (bucket < SUB_BUCKET_COUNT) {
+        return bucket;
+    }
+
+    int octave = bucket / SUB_BUCKET_COUNT + SUB_BUCKET_BITS - 1;
+    std::uint64_t sub_bucket = bucket % SUB_BUCKET_COUNT;
+    std::uint64_t lower_bound = (SUB_BUCKET_COUNT + sub_bucket)
+                                << (octave - SUB_BUCKET_BITS);
+    return lower_bound + ((1ULL << (octave - SUB_BUCKET_BITS)) - 1);
+}
+
+std::uint64_t LatencyHistogram::get_quantile(double quantile) const {
+    if (count_ == 0) {
+        return 0;
+    }
+
+    double rank = std::ceil(quantile * count_);
+    std::uint64_t count = 0;
+
+    for (int bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        count += counts_[bucket];
+
+        if (count >= rank) {
+            return std::min(get_bucket_upper_bound_(bucket), maximum_);
+        }
+    }
+
+    return maximum_;
+}
@@ -0,0 +1,80 @@
+#ifndef TYPETESTERDYNTRACER_LATENCY_HISTOGRAM_H
+#define TYPETESTERDYNTRACER_LATENCY_HISTOGRAM_H
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#    include <x86intrin.h>
+#endif
+
+/* the time stamp counter where there is one, a nanosecond clock elsewhere.
+   ticks are converted to nanoseconds by timing an interval on both clocks */
+inline std::uint64_t read_cycle_counter() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+}
+
+/* A log-linear histogram of durations in ticks, in the manner of
+   HdrHistogram. Durations below 16 have a bucket each, larger ones have 16
+   buckets per power of two, so quantiles are within 6.25% of the exact
+   ones. Recording a duration is a few instructions and the size of a
+   histogram is fixed. */
+class LatencyHistogram {
+  public:
+    LatencyHistogram(): count_(0), sum_(0), maximum_(0), counts_{0} {
+    }
+
+    void add(std::uint64_t duration) {
+        ++count_;
+        sum_ += duration;
+        maximum_ = duration > maximum_ ? duration : maximum_;
+        ++counts_[get_bucket_(duration)];
+    }
+
+    std::uint64_t get_count() const {
+        return count_;
+    }
+
+    double get_mean() const {
+        return count_ == 0 ? 0 : static_cast<double>(sum_) / count_;
+    }
+
+    std::uint64_t get_maximum() const {
+        return maximum_;
+    }
+
+    /* upper bound of the bucket holding the quantile, 0 < quantile <= 1 */
+    std::uint64_t get_quantile(double quantile) const;
+
+  private:
+    static const int SUB_BUCKET_BITS = 4;
+    static const int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static const int BUCKET_COUNT =
+        SUB_BUCKET_COUNT * (64 - SUB_BUCKET_BITS + 1);
+
+    static int get_bucket_(std::uint64_t duration) {
+        if (duration < SUB_BUCKET_COUNT) {
+            return duration;
+        }
+
+        int octave = 63 - __builtin_clzll(duration);
+        int sub_bucket =
+            (duration >> (octave - SUB_BUCKET_BITS)) & (SUB_BUCKET_COUNT - 1);
+        return SUB_BUCKET_COUNT * (octave - SUB_BUCKET_BITS + 1) + sub_bucket;
+    }
+
+    static std::uint64_t get_bucket_upper_bound_(int bucket);
+
+    std::uint64_t count_;
+    std::uint64_t sum_;
+    std::uint64_t maximum_;
+    std::uint64_t counts_[BUCKET_COUNT];
+};
+
+#endif /* TYPETESTERDYNTRACER_LATENCY_HISTOGRAM_H */
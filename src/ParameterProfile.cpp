@@ -0,0 +1,153 @@
+#include "ParameterProfile.h"
+
+#include "sexptypes.h"
+#include "typechecker.h"
+
+#include <cmath>
+#include <limits>
+
+ParameterProfile::ParameterProfile()
+    : value_count_(0)
+    , atomic_value_count_(0)
+    , na_value_count_(0)
+    , minimum_length_(std::numeric_limits<std::uint64_t>::max())
+    , maximum_length_(0)
+    , length_counts_{0}
+    , class_registers_{0} {
+}
+
+/* lengths below 4 have a bucket each, larger ones are bucketed by their
+   two bits after the leading one */
+int ParameterProfile::get_length_bucket_(std::uint64_t length) {
+    if (length < 4) {
+        return length;
+    }
+
+    int octave = 63 - __builtin_clzll(length);
+    int sub_bucket = (length >> (octave - 2)) & 3;
+    return 4 * (octave - 1) + sub_bucket;
+}
+
+std::uint64_t ParameterProfile::get_length_bucket_upper_bound_(int bucket) {
+    if (bucket < 4) {
+        return bucket;
+    }
+
+    int octave = bucket / 4 + 1;
+    std::uint64_t sub_bucket = bucket % 4;
+    return ((5 + sub_bucket) << (octave - 2)) - 1;
+}
+
+void ParameterProfile::add(SEXP value) {
+    switch (TYPEOF(value)) {
+    case LGLSXP:
+    case INTSXP:
+    case REALSXP:
+    case CPLXSXP:
+    case STRSXP:
+    case RAWSXP:
+        add(value, has_budgeted_na(value));
+        break;
+    default:
+        add(value, false);
+        break;
+    }
+}
+
+void ParameterProfile::add(SEXP value, bool na) {
+    std::uint64_t length = Rf_xlength(value);
+
+    ++value_count_;
+    ++length_counts_[get_length_bucket_(length)];
+    minimum_length_ = std::min(minimum_length_, length);
+    maximum_length_ = std::max(maximum_length_, length);
+
+    switch (TYPEOF(value)) {
+    case LGLSXP:
+    case INTSXP:
+    case REALSXP:
+    case CPLXSXP:
+    case STRSXP:
+    case RAWSXP:
+        ++atomic_value_count_;
+        if (na) {
+            ++na_value_count_;
+        }
+        break;
+    default:
+        break;
+    }
+
+    add_class_(value);
+}
+
+/* splitmix64 finalizer, std::hash of strings is not guaranteed to spread
+   its bits */
+static std::uint64_t mix_hash(std::uint64_t hash) {
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+void ParameterProfile::add_class_(SEXP value) {
+    std::string class_name;
+    SEXP klass = OBJECT(value) ? getAttrib(value, R_ClassSymbol) : R_NilValue;
+
+    if (TYPEOF(klass) == STRSXP) {
+        for (R_xlen_t i = 0; i < XLENGTH(klass); ++i) {
+            class_name.append(CHAR(STRING_ELT(klass, i)));
+            class_name.push_back(' ');
+        }
+    } else {
+        class_name = sexptype_to_string(TYPEOF(value));
+    }
+
+    std::uint64_t hash = mix_hash(std::hash<std::string>{}(class_name));
+    int index = hash >> 58;
+    std::uint8_t rank = __builtin_clzll((hash << 6) | (1ULL << 5)) + 1;
+
+    class_registers_[index] = std::max(class_registers_[index], rank);
+}
+
+std::uint64_t ParameterProfile::get_length_quantile(double quantile) const {
+    if (value_count_ == 0) {
+        return 0;
+    }
+
+    double rank = std::ceil(quantile * value_count_);
+    std::uint64_t count = 0;
+
+    for (int bucket = 0; bucket < LENGTH_BUCKET_COUNT; ++bucket) {
+        count += length_counts_[bucket];
+
+        if (count >= rank) {
+            return std::min(get_length_bucket_upper_bound_(bucket),
+                            maximum_length_);
+        }
+    }
+
+    return maximum_length_;
+}
+
+double ParameterProfile::get_distinct_class_estimate() const {
+    const double register_count = PROFILE_CLASS_REGISTER_COUNT;
+    double sum = 0;
+    int zero_count = 0;
+
+    for (std::uint8_t class_register: class_registers_) {
+        sum += std::ldexp(1.0, -class_register);
+        zero_count += class_register == 0;
+    }
+
+    double estimate = 0.709 * register_count * register_count / sum;
+
+    /* linear counting is more accurate for small cardinalities */
+    if (estimate <= 2.5 * register_count && zero_count != 0) {
+        estimate = register_count * std::log(register_count / zero_count);
+    }
+
+    return estimate;
+}
@@ -0,0 +1,71 @@
+#ifndef TYPETESTERDYNTRACER_PARAMETER_PROFILE_H
+#define TYPETESTERDYNTRACER_PARAMETER_PROFILE_H
+
+#include "stdlibs.h"
+
+#include <cstdint>
+
+/* A fixed size summary of the values seen by a parameter or return value.
+   Lengths are counted in a log-linear histogram with four buckets per
+   power of two, so quantiles are within 25% of the exact ones. NA rates
+   are counted over atomic vectors and are estimates: an NA is taken from
+   the shape the value was typechecked with when it has one, otherwise it
+   is only looked for within the typecheck budget, so NAs beyond the
+   elements the budget checks are missed. Distinct classes, the class
+   attribute or the sexptype of values without one, are estimated with a
+   HyperLogLog sketch of PROFILE_CLASS_REGISTER_COUNT registers. The size
+   of a profile does not depend on the number of values it has seen. */
+class ParameterProfile {
+  public:
+    ParameterProfile();
+
+    void add(SEXP value);
+
+    /* na is whether value has an NA if it is an atomic vector */
+    void add(SEXP value, bool na);
+
+    unsigned long get_value_count() const {
+        return value_count_;
+    }
+
+    unsigned long get_atomic_value_count() const {
+        return atomic_value_count_;
+    }
+
+    unsigned long get_na_value_count() const {
+        return na_value_count_;
+    }
+
+    std::uint64_t get_minimum_length() const {
+        return minimum_length_;
+    }
+
+    std::uint64_t get_maximum_length() const {
+        return maximum_length_;
+    }
+
+    /* upper bound of the bucket holding the quantile, 0 < quantile <= 1 */
+    std::uint64_t get_length_quantile(double quantile) const;
+
+    double get_distinct_class_estimate() const;
+
+  private:
+    static const int LENGTH_BUCKET_COUNT = 252;
+    static const int PROFILE_CLASS_REGISTER_COUNT = 64;
+
+    static int get_length_bucket_(std::uint64_t length);
+
+    static std::uint64_t get_length_bucket_upper_bound_(int bucket);
+
+    void add_class_(SEXP value);
+
+    unsigned long value_count_;
+    unsigned long atomic_value_count_;
+    unsigned long na_value_count_;
+    std::uint64_t minimum_length_;
+    std::uint64_t maximum_length_;
+    std::uint64_t length_counts_[LENGTH_BUCKET_COUNT];
+    std::uint8_t class_registers_[PROFILE_CLASS_REGISTER_COUNT];
+};
+
+#endif /* TYPETESTERDYNTRACER_PARAMETER_PROFILE_H */
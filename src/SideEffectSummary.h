@@ -73,6 +73,10 @@ class SideEffectSummary {
         return side_effect_count_;
     }
 
+    void increment_side_effect_count() {
+        side_effect_count_++;
+    }
+
     bool try_to_merge(const function_id_t& function_id,
                       int formal_parameter_position,
                       int actual_argument_position,
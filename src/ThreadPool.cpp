@@ -0,0 +1,56 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int thread_count): stopping_(false) {
+    for (int i = 0; i < thread_count; ++i) {
+        threads_.emplace_back(&ThreadPool::work_, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+
+    condition_.notify_all();
+
+    for (std::thread& thread: threads_) {
+        thread.join();
+    }
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task) {
+    std::packaged_task<void()> packaged_task(std::move(task));
+    std::future<void> future = packaged_task.get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push(std::move(packaged_task));
+    }
+
+    condition_.notify_one();
+
+    return future;
+}
+
+void ThreadPool::work_() {
+    while (true) {
+        std::packaged_task<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+
+            condition_.wait(lock,
+                            [this] { return stopping_ || !tasks_.empty(); });
+
+            if (tasks_.empty()) {
+                return;
+            }
+
+            task = std::move(tasks_.front());
+            tasks_.pop();
+        }
+
+        task();
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef TYPETESTERDYNTRACER_THREAD_POOL_H
+#define TYPETESTERDYNTRACER_THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/* A fixed set of worker threads executing tasks in submission order.
+   Tasks must not call into R, the R API is not thread safe. */
+class ThreadPool {
+  public:
+    explicit ThreadPool(int thread_count);
+
+    /* waits for the queued tasks to finish */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int get_thread_count() const {
+        return threads_.size();
+    }
+
+    std::future<void> submit(std::function<void()> task);
+
+  private:
+    void work_();
+
+    std::vector<std::thread> threads_;
+    std::queue<std::packaged_task<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stopping_;
+};
+
+#endif /* TYPETESTERDYNTRACER_THREAD_POOL_H */
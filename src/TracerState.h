@@ -1,18 +1,22 @@
 #ifndef TYPETESTERDYNTRACER_TRACER_STATE_H
 #define TYPETESTERDYNTRACER_TRACER_STATE_H
 
+#include "AggregateDataTable.h"
 #include "Argument.h"
 #include "Call.h"
 #include "ContextSensitiveLookupSummary.h"
 #include "Environment.h"
 #include "Event.h"
+#include "ExecutionClock.h"
 #include "ExecutionContextStack.h"
 #include "Function.h"
+#include "LatencyHistogram.h"
 #include "PromiseGcSummary.h"
 #include "PromiseLifecycleSummary.h"
 #include "SideEffectSummary.h"
 #include "TypeDeclarationCache.h"
 #include "Variable.h"
+#include "nascan.h"
 #include "sexptypes.h"
 #include "stdlibs.h"
 #include "typechecker.h"
@@ -28,28 +32,82 @@ class TracerState {
     const bool truncate_;
     const bool binary_;
     const int compression_level_;
+    const typecheck_budget_t typecheck_budget_;
+    const int na_scan_thread_count_;
+    const int na_scan_length_threshold_;
+    const std::vector<std::string> preload_type_declarations_;
+    const int preload_thread_count_;
+    const bool capture_value_shapes_;
+    const bool infer_signatures_;
+    const bool profile_parameters_;
+    const std::vector<std::string> aggregate_tables_;
+    const aggregate_keys_t aggregate_keys_;
+    const int aggregate_checkpoint_interval_;
+    const bool measure_probe_latency_;
+    const ExecutionClock execution_clock_;
 
   public:
-    TracerState(const std::string& type_declaration_dirpath,
+    TracerState(const std::vector<std::string>& type_declaration_dirpaths,
                 const std::string& output_dirpath,
                 bool verbose,
                 bool truncate,
                 bool binary,
-                int compression_level)
+                int compression_level,
+                const typecheck_budget_t& typecheck_budget,
+                int na_scan_thread_count,
+                int na_scan_length_threshold,
+                const std::vector<std::string>& preload_type_declarations,
+                int preload_thread_count,
+                bool capture_value_shapes,
+                bool infer_signatures,
+                bool profile_parameters,
+                const std::vector<std::string>& aggregate_tables,
+                const aggregate_keys_t& aggregate_keys,
+                int aggregate_checkpoint_interval,
+                bool measure_probe_latency,
+                ClockMode execution_clock)
         : output_dirpath_(output_dirpath)
         , verbose_(verbose)
         , truncate_(truncate)
         , binary_(binary)
         , compression_level_(compression_level)
+        , typecheck_budget_(typecheck_budget)
+        , na_scan_thread_count_(na_scan_thread_count)
+        , na_scan_length_threshold_(na_scan_length_threshold)
+        , preload_type_declarations_(preload_type_declarations)
+        , preload_thread_count_(preload_thread_count)
+        , capture_value_shapes_(capture_value_shapes)
+        , infer_signatures_(infer_signatures)
+        , profile_parameters_(profile_parameters)
+        , aggregate_tables_(aggregate_tables)
+        , aggregate_keys_(aggregate_keys)
+        , aggregate_checkpoint_interval_(aggregate_checkpoint_interval)
+        , measure_probe_latency_(measure_probe_latency)
+        , execution_clock_(execution_clock)
         , environment_id_(0)
+        , environment_generation_(0)
+        , execution_pause_ticks_(0)
+        , probe_overhead_(0)
+        , probe_function_(nullptr)
         , denoted_value_id_counter_(0)
         , variable_id_(0)
         , timestamp_(0)
+        , side_effect_memo_promise_(nullptr)
+        , side_effect_memo_argument_(nullptr)
         , call_id_counter_(0)
         , object_count_(OBJECT_TYPE_TABLE_COUNT, 0)
-        , event_counter_(to_underlying(Event::COUNT), 0)
+        , event_counter_{0}
         , argument_list_creation_mode_(false)
-        , type_declaration_cache_(type_declaration_dirpath) {
+        , type_declaration_dirpaths_(type_declaration_dirpaths)
+        , type_declaration_generation_(0)
+        , probe_entry_ticks_(read_cycle_counter())
+        , calibration_ticks_(probe_entry_ticks_)
+        , calibration_time_(std::chrono::steady_clock::now()) {
+        for (const std::string& dirpath: type_declaration_dirpaths_) {
+            type_declaration_caches_.push_back(
+                std::make_unique<TypeDeclarationCache>(dirpath));
+        }
+
         event_counts_data_table_ =
             create_data_table(output_dirpath_ + "/" + "event_counts",
                               {"event", "count"},
@@ -64,6 +122,37 @@ class TracerState {
                               binary_,
                               compression_level_);
 
+        /* created at the end of the trace if any ALTREP vector was
+           scanned */
+        altrep_scans_data_table_ = nullptr;
+
+        probe_latencies_data_table_ = create_optional_data_table_(
+            measure_probe_latency_,
+            "probe_latencies",
+            {"event", "count", "mean", "p50", "p99", "p999", "max"});
+
+        if (measure_probe_latency_) {
+            probe_latencies_.resize(to_underlying(Event::COUNT));
+        }
+
+        reset_altrep_scan_counts();
+
+        set_typecheck_budget(typecheck_budget_);
+
+        set_value_shape_capture(capture_value_shapes_ || infer_signatures_);
+
+        set_parameter_profiling(profile_parameters_);
+
+        configure_parallel_na_scan(na_scan_thread_count_,
+                                   na_scan_length_threshold_);
+
+        /* declarations are loaded while the traced program starts instead
+           of pausing it at the first call into each package */
+        for (auto& type_declaration_cache: type_declaration_caches_) {
+            type_declaration_cache->preload(preload_type_declarations_,
+                                            preload_thread_count_);
+        }
+
         call_summaries_data_table_ =
             create_data_table(output_dirpath_ + "/" + "call_summaries",
                               {"function_id",
@@ -109,33 +198,34 @@ class TracerState {
                               binary_,
                               compression_level_);
 
-        arguments_data_table_ =
-            create_data_table(output_dirpath_ + "/" + "arguments",
-                              {"call_id",
-                               "function_id",
-                               "value_id",
-                               "formal_parameter_position",
-                               "actual_argument_position",
-                               "argument_type",
-                               "expression_type",
-                               "value_type",
-                               "default",
-                               "dot_dot_dot",
-                               "preforce",
-                               "direct_force",
-                               "direct_lookup_count",
-                               "direct_metaprogram_count",
-                               "indirect_force",
-                               "indirect_lookup_count",
-                               "indirect_metaprogram_count",
-                               "S3_dispatch",
-                               "S4_dispatch",
-                               "forcing_actual_argument_position",
-                               "non_local_return",
-                               "execution_time"},
-                              truncate_,
-                              binary_,
-                              compression_level_);
+        create_event_table_("arguments",
+                            {"call_id",
+                             "function_id",
+                             "value_id",
+                             "formal_parameter_position",
+                             "actual_argument_position",
+                             "argument_type",
+                             "expression_type",
+                             "value_type",
+                             "default",
+                             "dot_dot_dot",
+                             "preforce",
+                             "direct_force",
+                             "direct_lookup_count",
+                             "direct_metaprogram_count",
+                             "indirect_force",
+                             "indirect_lookup_count",
+                             "indirect_metaprogram_count",
+                             "S3_dispatch",
+                             "S4_dispatch",
+                             "forcing_actual_argument_position",
+                             "non_local_return",
+                             "execution_time",
+                             "corrected_execution_time"},
+                            {"call_id", "value_id"},
+                            {"execution_time", "corrected_execution_time"},
+                            arguments_data_table_,
+                            arguments_aggregate_table_);
 
         side_effects_data_table_ =
             create_data_table(output_dirpath_ + "/" + "side_effects",
@@ -217,38 +307,40 @@ class TracerState {
              "after_escape_indirect_lexical_scope_observation_count",
              "after_escape_direct_non_lexical_scope_observation_count",
              "after_escape_indirect_non_lexical_scope_observation_count",
-             "execution_time"},
+             "execution_time",
+             "corrected_execution_time"},
             truncate_,
             binary_,
             compression_level_);
 
-        promises_data_table_ =
-            create_data_table(output_dirpath_ + "/" + "promises",
-                              {"value_id",
-                               "local",
-                               "argument",
-                               "expression_type",
-                               "value_type",
-                               "creation_scope",
-                               "forcing_scope",
-                               "S3_dispatch",
-                               "S4_dispatch",
-                               "preforce",
-                               "force_count",
-                               "call_depth",
-                               "promise_depth",
-                               "nested_promise_depth",
-                               "metaprogram_count",
-                               "value_lookup_count",
-                               "value_assign_count",
-                               "expression_lookup_count",
-                               "expression_assign_count",
-                               "environment_lookup_count",
-                               "environment_assign_count",
-                               "execution_time"},
-                              truncate_,
-                              binary_,
-                              compression_level_);
+        create_event_table_("promises",
+                            {"value_id",
+                             "local",
+                             "argument",
+                             "expression_type",
+                             "value_type",
+                             "creation_scope",
+                             "forcing_scope",
+                             "S3_dispatch",
+                             "S4_dispatch",
+                             "preforce",
+                             "force_count",
+                             "call_depth",
+                             "promise_depth",
+                             "nested_promise_depth",
+                             "metaprogram_count",
+                             "value_lookup_count",
+                             "value_assign_count",
+                             "expression_lookup_count",
+                             "expression_assign_count",
+                             "environment_lookup_count",
+                             "environment_assign_count",
+                             "execution_time",
+                             "corrected_execution_time"},
+                            {"value_id"},
+                            {"execution_time", "corrected_execution_time"},
+                            promises_data_table_,
+                            promises_aggregate_table_);
 
         context_sensitive_lookups_data_table_ = create_data_table(
             output_dirpath_ + "/" + "context_sensitive_lookups",
@@ -294,37 +386,99 @@ class TracerState {
                               binary_,
                               compression_level_);
 
-        typechecking_data_table_ =
-            create_data_table(output_dirpath_ + "/" + "typechecking",
-                              {"function_id",
-                               "call_id",
-                               "formal_parameter_position",
-                               "actual_argument_position",
-                               "is_default_argument",
-                               "is_dot_dot_dot",
-                               "is_forced",
-                               "outer_type",
-                               "inner_type",
-                               "match"},
-                              truncate_,
-                              binary_,
-                              compression_level_);
+        create_event_table_("typechecking",
+                            {"function_id",
+                             "call_id",
+                             "declaration_set",
+                             "formal_parameter_position",
+                             "actual_argument_position",
+                             "is_default_argument",
+                             "is_dot_dot_dot",
+                             "is_forced",
+                             "outer_type",
+                             "inner_type",
+                             "match",
+                             "value_shape_id"},
+                            {"call_id", "value_shape_id"},
+                            {},
+                            typechecking_data_table_,
+                            typechecking_aggregate_table_);
+
+        value_shapes_data_table_ =
+            create_optional_data_table_(capture_value_shapes_,
+                                        "value_shapes",
+                                        {"value_shape_id", "descriptor"});
+
+        inferred_signatures_data_table_ =
+            create_optional_data_table_(infer_signatures_,
+                                        "inferred_signatures",
+                                        {"function_id",
+                                         "package",
+                                         "function_name",
+                                         "observation_count",
+                                         "signature"});
+
+        parameter_profiles_data_table_ =
+            create_optional_data_table_(profile_parameters_,
+                                        "parameter_profiles",
+                                        {"function_id",
+                                         "formal_parameter_position",
+                                         "value_count",
+                                         "length_min",
+                                         "length_p50",
+                                         "length_p90",
+                                         "length_p99",
+                                         "length_max",
+                                         "atomic_value_count",
+                                         "na_value_count",
+                                         "distinct_class_estimate"});
+
+        tracer_overhead_by_function_data_table_ =
+            create_optional_data_table_(execution_clock_.is_enabled(),
+                                        "tracer_overhead_by_function",
+                                        {"function_id",
+                                         "package",
+                                         "function_names",
+                                         "probe_count",
+                                         "tracer_time",
+                                         "program_time"});
+
+        typechecking_saturation_data_table_ = create_optional_data_table_(
+            typecheck_budget_.saturation_threshold > 0,
+            "typechecking_saturation",
+            {"function_id",
+             "declaration_set",
+             "formal_parameter_position",
+             "value_shape",
+             "skipped_count"});
     }
 
     ~TracerState() {
+        configure_parallel_na_scan(0, 0);
+
         delete event_counts_data_table_;
         delete object_counts_data_table_;
+        delete altrep_scans_data_table_;
+        delete probe_latencies_data_table_;
         delete call_summaries_data_table_;
         delete substitute_summaries_data_table_;
         delete function_definitions_data_table_;
         delete arguments_data_table_;
+        delete arguments_aggregate_table_;
         delete side_effects_data_table_;
         delete promises_data_table_;
+        delete promises_aggregate_table_;
         delete escaped_arguments_data_table_;
         delete context_sensitive_lookups_data_table_;
         delete promise_lifecycles_data_table_;
         delete promise_gc_data_table_;
         delete typechecking_data_table_;
+        delete typechecking_aggregate_table_;
+        delete typechecking_saturation_data_table_;
+        delete value_shapes_data_table_;
+        delete inferred_signatures_data_table_;
+        delete parameter_profiles_data_table_;
+        delete tracer_overhead_by_function_data_table_;
     }
 
     const std::string& get_output_dirpath() const {
@@ -347,7 +501,58 @@ class TracerState {
         return compression_level_;
     }
 
-    void initialize() const {
+    const typecheck_budget_t& get_typecheck_budget() const {
+        return typecheck_budget_;
+    }
+
+    int get_na_scan_thread_count() const {
+        return na_scan_thread_count_;
+    }
+
+    int get_na_scan_length_threshold() const {
+        return na_scan_length_threshold_;
+    }
+
+    std::size_t get_preload_type_declaration_count() const {
+        return preload_type_declarations_.size();
+    }
+
+    int get_preload_thread_count() const {
+        return preload_thread_count_;
+    }
+
+    bool is_capturing_value_shapes() const {
+        return capture_value_shapes_;
+    }
+
+    bool is_inferring_signatures() const {
+        return infer_signatures_;
+    }
+
+    bool is_profiling_parameters() const {
+        return profile_parameters_;
+    }
+
+    bool is_aggregating_table(const std::string& name) const {
+        return std::find(aggregate_tables_.begin(),
+                         aggregate_tables_.end(),
+                         name) != aggregate_tables_.end();
+    }
+
+    int get_aggregate_checkpoint_interval() const {
+        return aggregate_checkpoint_interval_;
+    }
+
+    bool is_measuring_probe_latency() const {
+        return measure_probe_latency_;
+    }
+
+    const ExecutionClock& get_execution_clock() const {
+        return execution_clock_;
+    }
+
+    void initialize() {
+        calibrate_probe_overhead_();
         serialize_configuration_();
     }
 
@@ -368,8 +573,12 @@ class TracerState {
 
         serialize_event_counts_();
 
+        serialize_probe_latencies_();
+
         serialize_object_count_();
 
+        serialize_altrep_scans_();
+
         serialize_side_effects_();
 
         serialize_context_sensitive_lookups_();
@@ -378,6 +587,8 @@ class TracerState {
 
         serialize_promise_lifecycles_();
 
+        serialize_aggregate_tables_();
+
         if (!get_stack_().is_empty()) {
             dyntrace_log_error("stack not empty on tracer exit.")
         }
@@ -451,11 +662,21 @@ class TracerState {
   private:
     DataTableStream* event_counts_data_table_;
     DataTableStream* object_counts_data_table_;
+    DataTableStream* altrep_scans_data_table_;
+    DataTableStream* probe_latencies_data_table_;
     DataTableStream* promises_data_table_;
+    AggregateDataTable* promises_aggregate_table_;
     DataTableStream* context_sensitive_lookups_data_table_;
     DataTableStream* promise_lifecycles_data_table_;
     DataTableStream* promise_gc_data_table_;
     DataTableStream* typechecking_data_table_;
+    AggregateDataTable* typechecking_aggregate_table_;
+    DataTableStream* typechecking_saturation_data_table_;
+    DataTableStream* value_shapes_data_table_;
+    DataTableStream* inferred_signatures_data_table_;
+    DataTableStream* parameter_profiles_data_table_;
+    DataTableStream* tracer_overhead_by_function_data_table_;
+    std::unordered_map<std::string, int> value_shape_ids_;
 
     void serialize_configuration_() const {
         std::ofstream fout(get_output_dirpath() + "/CONFIGURATION",
@@ -471,11 +692,155 @@ class TracerState {
         }
 
         serialize_row("GIT_COMMIT_INFO", GIT_COMMIT_INFO);
+        for (std::size_t i = 0; i < type_declaration_dirpaths_.size(); ++i) {
+            serialize_row("declaration_set_" + std::to_string(i),
+                          type_declaration_dirpaths_[i]);
+        }
         serialize_row("truncate", std::to_string(get_truncate()));
         serialize_row("verbose", std::to_string(is_verbose()));
         serialize_row("binary", std::to_string(is_binary()));
         serialize_row("compression_level",
                       std::to_string(get_compression_level()));
+        serialize_row("typecheck_element_limit",
+                      std::to_string(get_typecheck_budget().element_limit));
+        serialize_row("typecheck_depth_limit",
+                      std::to_string(get_typecheck_budget().depth_limit));
+        serialize_row("typecheck_sampling",
+                      std::to_string(get_typecheck_budget().sampling));
+        serialize_row(
+            "typecheck_saturation_threshold",
+            std::to_string(get_typecheck_budget().saturation_threshold));
+        serialize_row("na_scan_thread_count",
+                      std::to_string(get_na_scan_thread_count()));
+        serialize_row("na_scan_length_threshold",
+                      std::to_string(get_na_scan_length_threshold()));
+        serialize_row("na_scan_variant", get_na_scan_variant());
+        serialize_row("preload_type_declaration_count",
+                      std::to_string(get_preload_type_declaration_count()));
+        serialize_row("preload_thread_count",
+                      std::to_string(get_preload_thread_count()));
+        serialize_row("capture_value_shapes",
+                      std::to_string(is_capturing_value_shapes()));
+        serialize_row("infer_signatures",
+                      std::to_string(is_inferring_signatures()));
+        serialize_row("profile_parameters",
+                      std::to_string(is_profiling_parameters()));
+        for (const std::string& name: aggregate_tables_) {
+            std::string key_column_names;
+            auto iter = aggregate_keys_.find(name);
+
+            if (iter != aggregate_keys_.end()) {
+                for (const std::string& column_name: iter->second) {
+                    key_column_names.append(key_column_names.empty() ? ""
+                                                                     : " ");
+                    key_column_names.append(column_name);
+                }
+            }
+
+            serialize_row("aggregate_" + name, key_column_names);
+        }
+        serialize_row("aggregate_checkpoint_interval",
+                      std::to_string(get_aggregate_checkpoint_interval()));
+        serialize_row("measure_probe_latency",
+                      std::to_string(is_measuring_probe_latency()));
+        serialize_row("requested_execution_clock",
+                      to_string(get_execution_clock().get_requested_mode()));
+        serialize_row("execution_clock",
+                      to_string(get_execution_clock().get_mode()));
+        serialize_row(
+            "execution_clock_nanoseconds_per_tick",
+            std::to_string(get_execution_clock().get_nanoseconds_per_tick()));
+        serialize_row("probe_overhead", std::to_string(get_probe_overhead()));
+    }
+
+    /* tables of analyses that are not enabled are not created, so runs
+       without them do not write empty files */
+    DataTableStream*
+    create_optional_data_table_(bool enabled,
+                                const std::string& name,
+                                const std::vector<std::string>& column_names) {
+        if (!enabled) {
+            return nullptr;
+        }
+
+        return create_data_table(output_dirpath_ + "/" + name,
+                                 column_names,
+                                 truncate_,
+                                 binary_,
+                                 compression_level_);
+    }
+
+    /* tables that are not aggregated are created as usual. An aggregated
+       table is reduced by its configured key columns, or by all its columns
+       other than the id and timing ones if none are configured. */
+    void create_event_table_(
+        const std::string& name,
+        const std::vector<std::string>& column_names,
+        const std::vector<std::string>& id_column_names,
+        const std::vector<std::string>& timing_column_names,
+        DataTableStream*& data_table,
+        AggregateDataTable*& aggregate_table) {
+        data_table = nullptr;
+        aggregate_table = nullptr;
+
+        if (!is_aggregating_table(name)) {
+            data_table = create_data_table(output_dirpath_ + "/" + name,
+                                           column_names,
+                                           truncate_,
+                                           binary_,
+                                           compression_level_);
+            return;
+        }
+
+        std::vector<std::string> key_column_names;
+        auto iter = aggregate_keys_.find(name);
+
+        if (iter != aggregate_keys_.end()) {
+            key_column_names = iter->second;
+        } else {
+            for (const std::string& column_name: column_names) {
+                if (std::find(id_column_names.begin(),
+                              id_column_names.end(),
+                              column_name) == id_column_names.end() &&
+                    std::find(timing_column_names.begin(),
+                              timing_column_names.end(),
+                              column_name) == timing_column_names.end()) {
+                    key_column_names.push_back(column_name);
+                }
+            }
+        }
+
+        aggregate_table =
+            new AggregateDataTable(output_dirpath_ + "/" + name,
+                                   column_names,
+                                   key_column_names,
+                                   timing_column_names,
+                                   aggregate_checkpoint_interval_,
+                                   truncate_,
+                                   binary_,
+                                   compression_level_);
+    }
+
+    template <typename... Args>
+    static void write_event_row_(DataTableStream* data_table,
+                                 AggregateDataTable* aggregate_table,
+                                 Args... fields) {
+        if (aggregate_table != nullptr) {
+            aggregate_table->write_row(fields...);
+        } else {
+            data_table->write_row(fields...);
+        }
+    }
+
+    void serialize_aggregate_tables_() {
+        for (AggregateDataTable* aggregate_table:
+             {arguments_aggregate_table_,
+              promises_aggregate_table_,
+              typechecking_aggregate_table_}) {
+            if (aggregate_table != nullptr) {
+                aggregate_table->checkpoint();
+            }
+        }
     }
 
     void serialize_event_counts_() {
@@ -486,6 +851,38 @@ class TracerState {
         }
     }
 
+    /* latencies are measured in ticks of the cycle counter, they are
+       written in nanoseconds using the tick rate over the whole trace */
+    void serialize_probe_latencies_() {
+        if (probe_latencies_data_table_ == nullptr) {
+            return;
+        }
+
+        std::uint64_t ticks = read_cycle_counter() - calibration_ticks_;
+        double nanoseconds =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - calibration_time_)
+                .count();
+        double nanoseconds_per_tick = ticks == 0 ? 1 : nanoseconds / ticks;
+
+        for (int i = 0; i < to_underlying(Event::COUNT); ++i) {
+            const LatencyHistogram& histogram = probe_latencies_[i];
+
+            if (histogram.get_count() == 0) {
+                continue;
+            }
+
+            probe_latencies_data_table_->write_row(
+                to_string(static_cast<Event>(i)),
+                static_cast<double>(histogram.get_count()),
+                histogram.get_mean() * nanoseconds_per_tick,
+                histogram.get_quantile(0.5) * nanoseconds_per_tick,
+                histogram.get_quantile(0.99) * nanoseconds_per_tick,
+                histogram.get_quantile(0.999) * nanoseconds_per_tick,
+                histogram.get_maximum() * nanoseconds_per_tick);
+        }
+    }
+
     void serialize_object_count_() {
         for (int i = 0; i < object_count_.size(); ++i) {
             if (object_count_[i] != 0) {
@@ -496,6 +893,32 @@ class TracerState {
         }
     }
 
+    void serialize_altrep_scans_() {
+        unsigned long scan_count = 0;
+
+        for (int i = 0; i < to_underlying(AltrepScan::COUNT); ++i) {
+            scan_count += get_altrep_scan_count(static_cast<AltrepScan>(i));
+        }
+
+        if (scan_count == 0) {
+            return;
+        }
+
+        altrep_scans_data_table_ =
+            create_data_table(output_dirpath_ + "/" + "altrep_scans",
+                              {"scan", "count"},
+                              truncate_,
+                              binary_,
+                              compression_level_);
+
+        for (int i = 0; i < to_underlying(AltrepScan::COUNT); ++i) {
+            AltrepScan altrep_scan = static_cast<AltrepScan>(i);
+            altrep_scans_data_table_->write_row(
+                to_string(altrep_scan),
+                static_cast<double>(get_altrep_scan_count(altrep_scan)));
+        }
+    }
+
     void serialize_side_effects_() {
         for (const SideEffectSummary& summary: side_effect_summaries_) {
             side_effects_data_table_->write_row(
@@ -609,11 +1032,133 @@ class TracerState {
             .remove(symbol_to_string(symbol));
     }
 
+    /* is env_a a parent of env_b. This gives the same answer as the
+       function of the same name in utilities.h but uses the cached ancestry
+       of tracked environments to avoid walking the ENCLOS chain. The ENCLOS
+       link of env_b, env_a and of every skip target followed is checked,
+       a rewired one drops the cached ancestry and the chain is walked.
+       Ancestors rewired between two skip targets by code that is not
+       traced, such as SET_ENCLOS from C, are not detected until the
+       ancestry is next invalidated. */
+    bool is_parent_environment(SEXP env_a, SEXP env_b) {
+        if (env_a == env_b || TYPEOF(env_a) != ENVSXP ||
+            TYPEOF(env_b) != ENVSXP) {
+            return false;
+        }
+
+        int ancestor_depth = refresh_ancestry_(env_a).get_depth();
+        int generation = environment_generation_;
+        const Environment* record = &refresh_ancestry_(env_b);
+
+        /* refreshing env_b may have discovered a modified ENCLOS link and
+           invalidated the depth of env_a. */
+        if (generation != environment_generation_) {
+            ancestor_depth = refresh_ancestry_(env_a).get_depth();
+        }
+
+        SEXP current = env_b;
+        int depth = record->get_depth();
+
+        if (depth <= ancestor_depth) {
+            return false;
+        }
+
+        while (record->get_skip_depth() >= ancestor_depth &&
+               record->get_skip_depth() < depth) {
+            current = record->get_skip();
+            depth = record->get_skip_depth();
+            record = &lookup_environment(current);
+
+            if (record->get_generation() != environment_generation_ ||
+                ENCLOS(current) != record->get_parent()) {
+                invalidate_environment_ancestry();
+                return ::is_parent_environment(env_a, env_b);
+            }
+        }
+
+        while (depth > ancestor_depth) {
+            current = ENCLOS(current);
+            --depth;
+        }
+
+        return current == env_a;
+    }
+
+    /* called when the program may have rewired ENCLOS links of existing
+       environments, for example through parent.env<- or attach. Rewires
+       by other means are only caught where a cached link is checked. */
+    void invalidate_environment_ancestry() {
+        ++environment_generation_;
+    }
+
   private:
     env_id_t create_next_environment_id_() {
         return environment_id_++;
     }
 
+    Environment& refresh_ancestry_(const SEXP rho) {
+        Environment& environment = lookup_environment(rho);
+
+        if (environment.get_generation() == environment_generation_) {
+            if (ENCLOS(rho) == environment.get_parent()) {
+                return environment;
+            }
+            invalidate_environment_ancestry();
+        }
+
+        /* collect the stale part of the chain, the first fresh ancestor
+           and everything above it can be trusted. */
+        std::vector<Environment*>& chain = environment_ancestry_chain_;
+        chain.clear();
+        chain.push_back(&environment);
+
+        for (SEXP parent = ENCLOS(rho); parent != R_NilValue;
+             parent = ENCLOS(parent)) {
+            Environment& ancestor = lookup_environment(parent);
+
+            if (ancestor.get_generation() == environment_generation_) {
+                if (ENCLOS(parent) == ancestor.get_parent()) {
+                    break;
+                }
+                invalidate_environment_ancestry();
+            }
+
+            chain.push_back(&ancestor);
+        }
+
+        for (auto iter = chain.rbegin(); iter != chain.rend(); ++iter) {
+            Environment& current = **iter;
+            SEXP parent = ENCLOS(current.get_rho());
+
+            if (parent == R_NilValue) {
+                current.set_ancestry(
+                    R_NilValue, -1, 0, R_NilValue, 0, environment_generation_);
+                continue;
+            }
+
+            const Environment& ancestor = lookup_environment(parent);
+            const int depth = ancestor.get_depth();
+
+            if (depth % ENVIRONMENT_SKIP_DISTANCE == 0) {
+                current.set_ancestry(parent,
+                                     ancestor.get_id(),
+                                     depth + 1,
+                                     parent,
+                                     depth,
+                                     environment_generation_);
+            } else {
+                current.set_ancestry(parent,
+                                     ancestor.get_id(),
+                                     depth + 1,
+                                     ancestor.get_skip(),
+                                     ancestor.get_skip_depth(),
+                                     environment_generation_);
+            }
+        }
+
+        return environment;
+    }
+
     var_id_t create_next_variable_id_() {
         return variable_id_++;
     }
@@ -621,22 +1166,51 @@ class TracerState {
     env_id_t environment_id_;
     var_id_t variable_id_;
     std::unordered_map<SEXP, Environment> environment_mapping_;
+    int environment_generation_;
+    std::vector<Environment*> environment_ancestry_chain_;
 
   public:
     void resume_execution_timer() {
-        execution_resume_time_ = std::chrono::high_resolution_clock::now();
+        if (execution_clock_.is_enabled()) {
+            execution_resume_ticks_ = execution_clock_.read();
+            attribute_tracer_time_(execution_clock_.to_nanoseconds(
+                execution_resume_ticks_ - execution_pause_ticks_));
+        }
     }
 
-    void pause_execution_timer() {
-        auto execution_pause_time = std::chrono::high_resolution_clock::now();
-        std::uint64_t execution_time =
-            std::chrono::duration_cast<std::chrono::nanoseconds>(
-                execution_pause_time - execution_resume_time_)
-                .count();
+    /* returns the time charged to the context on top of the stack */
+    std::uint64_t pause_execution_timer() {
+        if (!execution_clock_.is_enabled()) {
+            return 0;
+        }
+
+        execution_pause_ticks_ = execution_clock_.read();
+        std::uint64_t execution_time = execution_clock_.to_nanoseconds(
+            execution_pause_ticks_ - execution_resume_ticks_);
         ExecutionContextStack& stack(get_stack_());
         if (!stack.is_empty()) {
             stack.peek(1).increment_execution_time(execution_time);
+            stack.peek(1).increment_probe_count(1);
         }
+        probe_function_ = get_innermost_closure_function_();
+        if (probe_function_ != nullptr) {
+            probe_function_->add_program_time(execution_time);
+        }
+        return execution_time;
+    }
+
+    /* nanoseconds of tracer work charged to a context by each probe */
+    std::uint64_t get_probe_overhead() const {
+        return probe_overhead_;
+    }
+
+    /* the execution time of the context without the calibrated overhead of
+       the probes that ran in it */
+    std::uint64_t
+    get_corrected_execution_time(const ExecutionContext& context) const {
+        std::uint64_t overhead = context.get_probe_count() * probe_overhead_;
+        std::uint64_t execution_time = context.get_execution_time();
+        return execution_time > overhead ? execution_time - overhead : 0;
     }
 
     ExecutionContext pop_stack() {
@@ -645,6 +1219,10 @@ class TracerState {
         if (!stack.is_empty()) {
             stack.peek(1).increment_execution_time(
                 exec_ctxt.get_execution_time());
+            stack.peek(1).increment_probe_count(exec_ctxt.get_probe_count());
+        }
+        if (exec_ctxt.is_promise()) {
+            reset_side_effect_memo_();
         }
         return exec_ctxt;
     }
@@ -654,13 +1232,80 @@ class TracerState {
         get_stack_().push(context);
     }
 
-    execution_contexts_t unwind_stack(const RCNTXT* context) {
-        return get_stack_().unwind(ExecutionContext(context));
+    const execution_contexts_t& unwind_stack(const RCNTXT* context) {
+        reset_side_effect_memo_();
+        return get_stack_().unwind(context);
     }
 
   private:
-    std::chrono::time_point<std::chrono::high_resolution_clock>
-        execution_resume_time_;
+    Function* get_innermost_closure_function_() {
+        ExecutionContextStack& stack(get_stack_());
+        int index = stack.get_closure_index();
+        return index == -1 ? nullptr
+                           : stack.at(index).get_closure()->get_function();
+    }
+
+    /* the time of a probe is charged to the innermost closure when it
+       started, the probe may have pushed or popped calls by the time it
+       returns. The callee of closure_exit is charged for the typechecking
+       and serialization of its call. Functions are only destroyed by
+       cleanup, so the pointer is still valid when the probe returns. */
+    void attribute_tracer_time_(std::uint64_t tracer_time) {
+        if (probe_function_ != nullptr) {
+            probe_function_->add_tracer_time(tracer_time);
+        }
+    }
+
+    /* The time between the clock reads of exit_probe and of the next
+       enter_probe is charged to the running context, including the tracer
+       work around the reads. This measures it as the median time charged to
+       a placeholder context by an exit_probe and enter_probe pair, with the
+       latency histogram update and the stack and function bookkeeping. The
+       event count, latencies and timestamp the pairs changed are restored
+       afterwards. */
+    void calibrate_probe_overhead_() {
+        const Event event = Event::DyntraceEntry;
+        const std::size_t event_index = to_underlying(event);
+        const std::uint64_t event_count = event_counter_[event_index];
+        const timestamp_t timestamp = timestamp_;
+        LatencyHistogram probe_latency;
+
+        if (measure_probe_latency_) {
+            probe_latency = probe_latencies_[event_index];
+        }
+
+        ExecutionContextStack& stack(get_stack_());
+        stack.push(static_cast<DenotedValue*>(nullptr));
+
+        std::vector<std::uint64_t> samples;
+
+        for (int i = 0; i < PROBE_OVERHEAD_CALIBRATION_COUNT; ++i) {
+            exit_probe(event);
+            std::uint64_t execution_time = stack.peek(1).get_execution_time();
+            enter_probe(event);
+            samples.push_back(stack.peek(1).get_execution_time() -
+                              execution_time);
+        }
+
+        stack.pop();
+
+        event_counter_[event_index] = event_count;
+        timestamp_ = timestamp;
+
+        if (measure_probe_latency_) {
+            probe_latencies_[event_index] = probe_latency;
+        }
+
+        std::nth_element(samples.begin(),
+                         samples.begin() + samples.size() / 2,
+                         samples.end());
+        probe_overhead_ = samples[samples.size() / 2];
+    }
+
+    std::uint64_t execution_resume_ticks_;
+    std::uint64_t execution_pause_ticks_;
+    std::uint64_t probe_overhead_;
+    Function* probe_function_;
 
     /***************************************************************************
      * PROMISE
@@ -741,7 +1386,9 @@ class TracerState {
     }
 
     void serialize_promise_(DenotedValue* promise) {
-        promises_data_table_->write_row(
+        write_event_row_(
+            promises_data_table_,
+            promises_aggregate_table_,
             promise->get_id(),
             promise->is_local(),
             promise->was_argument(),
@@ -763,7 +1410,8 @@ class TracerState {
             promise->get_expression_assign_count(),
             promise->get_environment_lookup_count(),
             promise->get_environment_assign_count(),
-            promise->get_execution_time());
+            promise->get_execution_time(),
+            promise->get_corrected_execution_time());
     }
 
     void serialize_escaped_promise_(DenotedValue* promise) {
@@ -832,7 +1480,8 @@ class TracerState {
             promise->get_non_lexical_scope_observation_count_after_escape(true),
             promise->get_non_lexical_scope_observation_count_after_escape(
                 false),
-            promise->get_execution_time());
+            promise->get_execution_time(),
+            promise->get_corrected_execution_time());
     }
 
     DenotedValue* create_raw_promise_(const SEXP promise, bool local) {
@@ -868,52 +1517,69 @@ class TracerState {
     scope_t infer_creation_scope() {
         ExecutionContextStack& stack = get_stack_();
 
-        for (auto iter = stack.crbegin(); iter != stack.crend(); ++iter) {
-            if (iter->is_call()) {
-                const Function* const function =
-                    iter->get_call()->get_function();
-                /* '{' function as promise creation source is not very
-                   insightful. We want to keep going back until we find
-                   something meaningful. */
-                if (!function->is_curly_bracket()) {
-                    return function->get_id();
-                }
-            }
+        /* '{' function as promise creation source is not very insightful.
+           The stack keeps track of the nearest call that is not '{'. */
+        int index = stack.get_non_curly_call_index();
+
+        if (index == -1) {
+            return TOP_LEVEL_SCOPE;
         }
-        return TOP_LEVEL_SCOPE;
+
+        return stack.at(index).get_call()->get_function()->get_id();
     }
 
     scope_t infer_forcing_scope() {
         const ExecutionContextStack& stack = get_stack_();
 
-        for (auto iter = stack.crbegin(); iter != stack.crend(); ++iter) {
-            const ExecutionContext& exec_ctxt = *iter;
+        int index = stack.get_non_r_context_index();
 
-            if (exec_ctxt.is_r_context()) {
-                continue;
-            } else if (exec_ctxt.is_promise()) {
-                return "Promise";
-            } else {
-                return exec_ctxt.get_call()->get_function_name();
-            }
+        if (index == -1) {
+            return TOP_LEVEL_SCOPE;
         }
 
-        return TOP_LEVEL_SCOPE;
+        const ExecutionContext& exec_ctxt = stack.at(index);
+
+        if (exec_ctxt.is_promise()) {
+            return "Promise";
+        }
+
+        return exec_ctxt.get_call()->get_function_name();
     }
 
     void exit_probe(const Event event) {
         resume_execution_timer();
+
+        if (measure_probe_latency_) {
+            probe_latencies_[to_underlying(event)].add(read_cycle_counter() -
+                                                       probe_entry_ticks_);
+        }
     }
 
     void enter_probe(const Event event) {
+        if (measure_probe_latency_) {
+            probe_entry_ticks_ = read_cycle_counter();
+        }
+
         pause_execution_timer();
         increment_timestamp_();
         ++event_counter_[to_underlying(event)];
     }
 
+    /* probes of lazy events only count them. They neither read the clock
+       nor advance the timestamp, the time they take is attributed to the
+       current execution context by the next probe that pauses the timer. */
+    void count_event(const Event event) {
+        ++event_counter_[to_underlying(event)];
+    }
+
     Call* find_call(SEXP environment, sexptype_t call_type) {
         ExecutionContextStack& stack = get_stack_();
 
+        if (call_type == CLOSXP) {
+            int index = stack.find_closure_index(environment);
+            return index == -1 ? nullptr : stack.at(index).get_call();
+        }
+
         for (auto iter = stack.crbegin(); iter != stack.crend(); ++iter) {
             if (iter->is_call()) {
                 Call* call = iter->get_call();
@@ -930,6 +1596,11 @@ class TracerState {
     Call* get_parent_caller(sexptype_t call_type) {
         ExecutionContextStack& stack = get_stack_();
 
+        if (call_type == CLOSXP) {
+            int index = stack.get_closure_index();
+            return index == -1 ? nullptr : stack.at(index).get_call();
+        }
+
         for (auto iter = stack.crbegin(); iter != stack.crend(); ++iter) {
             if (iter->is_call()) {
                 Call* call = iter->get_call();
@@ -953,10 +1624,8 @@ class TracerState {
 
         function_call = new Call(call_id, function_name, rho, function);
 
-        if (function->has_invalid_type_declaration()) {
-            function->set_type_declaration(
-                get_type_declaration(function->get_namespace(), function_name));
-        }
+        resolve_type_declaration_(
+            function, get_function_symbol_(call), function_name);
 
         if (TYPEOF(op) == CLOSXP) {
             process_closure_arguments_(function_call, op);
@@ -973,6 +1642,10 @@ class TracerState {
 
         function->add_summary(call);
 
+        if (function->rewires_environments()) {
+            invalidate_environment_ancestry();
+        }
+
         for (Argument* argument: call->get_arguments()) {
             serialize_argument_(argument);
 
@@ -1039,11 +1712,35 @@ class TracerState {
         arg->typecheck(argument);
     }
 
+    /* The frame of a new closure environment is built by matching the
+       arguments to the formals. So it holds one binding per formal, in
+       formal order, possibly preceded by variables defined later, such as
+       the dispatch variables of UseMethod. Instead of looking up each
+       formal by name, which is a linear scan of the unhashed frame, the
+       frame is walked once alongside the formals. */
+    SEXP lookup_closure_argument_(SEXP rho, SEXP& frame, SEXP name) {
+        if (HASHTAB(rho) != R_NilValue) {
+            return dyntrace_lookup_environment(rho, name);
+        }
+
+        for (SEXP binding = frame; binding != R_NilValue;
+             binding = CDR(binding)) {
+            if (TAG(binding) == name) {
+                frame = CDR(binding);
+                return CAR(binding);
+            }
+        }
+
+        /* the frame does not follow formal order, fall back to lookup */
+        return dyntrace_lookup_environment(rho, name);
+    }
+
     void process_closure_arguments_(Call* call, const SEXP op) {
         SEXP formal = nullptr;
         SEXP name = nullptr;
         SEXP argument = nullptr;
         SEXP rho = call->get_environment();
+        SEXP frame = FRAME(rho);
         int formal_parameter_position = -1;
         int actual_argument_position = -1;
 
@@ -1053,7 +1750,7 @@ class TracerState {
             /* get argument name */
             name = TAG(formal);
             /* lookup argument in environment by name */
-            argument = dyntrace_lookup_environment(rho, name);
+            argument = lookup_closure_argument_(rho, frame, name);
 
             switch (type_of_sexp(argument)) {
             case DOTSXP:
@@ -1093,7 +1790,9 @@ class TracerState {
         Function* function = call->get_function();
         DenotedValue* value = argument->get_denoted_value();
 
-        arguments_data_table_->write_row(
+        write_event_row_(
+            arguments_data_table_,
+            arguments_aggregate_table_,
             call->get_id(),
             function->get_id(),
             value->get_id(),
@@ -1115,10 +1814,12 @@ class TracerState {
             argument->used_for_S4_dispatch(),
             argument->get_forcing_actual_argument_position(),
             argument->does_non_local_return(),
-            value->get_execution_time());
+            value->get_execution_time(),
+            value->get_corrected_execution_time());
     }
 
     DataTableStream* arguments_data_table_;
+    AggregateDataTable* arguments_aggregate_table_;
     DataTableStream* side_effects_data_table_;
     DataTableStream* escaped_arguments_data_table_;
 
@@ -1177,6 +1878,95 @@ class TracerState {
         serialize_function_call_summary_(function, all_names);
         serialize_substitute_function_summary_(function, all_names);
         serialize_function_definition_(function, all_names);
+        serialize_function_typechecking_saturation_(function);
+        serialize_function_inferred_signature_(function, all_names);
+        serialize_function_parameter_profiles_(function);
+        serialize_function_tracer_overhead_(function, all_names);
+    }
+
+    /* times are in nanoseconds */
+    void serialize_function_tracer_overhead_(const Function* function,
+                                             const std::string& names) {
+        if (tracer_overhead_by_function_data_table_ == nullptr) {
+            return;
+        }
+
+        if (function->get_probe_count() == 0 &&
+            function->get_program_time() == 0) {
+            return;
+        }
+
+        tracer_overhead_by_function_data_table_->write_row(
+            function->get_id(),
+            function->get_namespace(),
+            names,
+            static_cast<double>(function->get_probe_count()),
+            static_cast<double>(function->get_tracer_time()),
+            static_cast<double>(function->get_program_time()));
+    }
+
+    void serialize_function_parameter_profiles_(const Function* function) {
+        if (parameter_profiles_data_table_ == nullptr) {
+            return;
+        }
+
+        const std::vector<ParameterProfile>& profiles =
+            function->get_parameter_profiles();
+
+        for (std::size_t index = 0; index < profiles.size(); ++index) {
+            const ParameterProfile& profile = profiles[index];
+
+            if (profile.get_value_count() == 0) {
+                continue;
+            }
+
+            parameter_profiles_data_table_->write_row(
+                function->get_id(),
+                static_cast<int>(index) - 1,
+                static_cast<double>(profile.get_value_count()),
+                static_cast<double>(profile.get_minimum_length()),
+                static_cast<double>(profile.get_length_quantile(0.5)),
+                static_cast<double>(profile.get_length_quantile(0.9)),
+                static_cast<double>(profile.get_length_quantile(0.99)),
+                static_cast<double>(profile.get_maximum_length()),
+                static_cast<double>(profile.get_atomic_value_count()),
+                static_cast<double>(profile.get_na_value_count()),
+                profile.get_distinct_class_estimate());
+        }
+    }
+
+    void serialize_function_inferred_signature_(const Function* function,
+                                                const std::string& names) {
+        const InferredSignature& signature = function->get_inferred_signature();
+
+        if (inferred_signatures_data_table_ == nullptr ||
+            signature.get_observation_count() == 0) {
+            return;
+        }
+
+        inferred_signatures_data_table_->write_row(
+            function->get_id(),
+            function->get_namespace(),
+            names,
+            static_cast<double>(signature.get_observation_count()),
+            signature.to_string(function->get_formal_parameter_count()));
+    }
+
+    void serialize_function_typechecking_saturation_(const Function* function) {
+        if (typechecking_saturation_data_table_ == nullptr) {
+            return;
+        }
+
+        for (const auto& entry: function->get_skipped_typechecks()) {
+            const skipped_typecheck_t& skipped = entry.first;
+
+            typechecking_saturation_data_table_->write_row(
+                function->get_id(),
+                std::get<0>(skipped),
+                std::get<1>(skipped),
+                value_shape_to_string(std::get<2>(skipped)),
+                static_cast<double>(entry.second));
+        }
     }
 
     void serialize_function_call_summary_(const Function* function,
@@ -1234,70 +2024,54 @@ class TracerState {
 
   public:
     void identify_side_effect_creators(const Variable& var, const SEXP env) {
-        bool direct = true;
         ExecutionContextStack& stack = get_stack_();
 
-        for (auto iter = stack.rbegin(); iter != stack.rend(); ++iter) {
-            ExecutionContext& exec_ctxt = *iter;
+        /* most of the time no promise is being forced and there is nobody
+           to hold responsible for the side effect. */
+        if (!stack.has_active_promise()) {
+            return;
+        }
 
-            if (exec_ctxt.is_closure()) {
-                if (exec_ctxt.get_closure()->get_environment() == env) {
-                    /* its normal for a function to mutate variables in its
-                       own environment. this case is not interesting. */
-                    return;
-                } else {
-                    direct = false;
-                }
-            }
+        const int promise_index = stack.get_promise_index();
 
-            if (exec_ctxt.is_promise()) {
-                DenotedValue* promise = exec_ctxt.get_promise();
-
-                const SEXP prom_env = promise->get_environment();
-
-                const timestamp_t var_timestamp =
-                    var.get_modification_timestamp();
-
-                if (prom_env == env) {
-                    // if (promise->get_creation_timestamp() > var_timestamp) {
-                    add_side_effect_summary(true,
-                                            SideEffectMode::SameEnvironment,
-                                            direct,
-                                            promise,
-                                            var.get_name());
-                    promise->set_self_scope_mutation(direct);
-                    direct = false;
-                    return;
-                } else if (is_parent_environment(env, prom_env)) {
-                    add_side_effect_summary(true,
-                                            SideEffectMode::LexicalEnvironment,
-                                            direct,
-                                            promise,
-                                            var.get_name());
-                    // if (promise->get_creation_timestamp() > var_timestamp) {
-                    /* if this happens, promise is causing side effect
-                       in its lexically scoped environment. */
-                    promise->set_lexical_scope_mutation(direct);
-                    direct = false;
-                    return;
-                } else {
-                    add_side_effect_summary(true,
-                                            SideEffectMode::OtherEnvironment,
-                                            direct,
-                                            promise,
-                                            var.get_name());
-                    // if (promise->get_creation_timestamp() > var_timestamp) {
-                    /* if this happens, promise is causing side effect
-                       in non lexically scoped environment */
-                    promise->set_non_lexical_scope_mutation(direct);
-                    direct = false;
-                    return;
-                }
-            }
+        if (stack.find_closure_index(env) > promise_index) {
+            /* its normal for a function to mutate variables in its
+               own environment. this case is not interesting. */
+            return;
+        }
+
+        bool direct = stack.get_closure_count_above(promise_index) == 0;
+
+        DenotedValue* promise = stack.at(promise_index).get_promise();
+
+        const SEXP prom_env = promise->get_environment();
+
+        if (prom_env == env) {
+            record_side_effect_(
+                true, SideEffectMode::SameEnvironment, direct, promise, var);
+            promise->set_self_scope_mutation(direct);
+        } else if (is_parent_environment(env, prom_env)) {
+            record_side_effect_(
+                true, SideEffectMode::LexicalEnvironment, direct, promise, var);
+            /* if this happens, promise is causing side effect
+               in its lexically scoped environment. */
+            promise->set_lexical_scope_mutation(direct);
+        } else {
+            record_side_effect_(
+                true, SideEffectMode::OtherEnvironment, direct, promise, var);
+            /* if this happens, promise is causing side effect
+               in non lexically scoped environment */
+            promise->set_non_lexical_scope_mutation(direct);
         }
     }
 
     void identify_side_effect_observers(const Variable& var, const SEXP env) {
+        ExecutionContextStack& stack = get_stack_();
+
+        if (!stack.has_active_promise()) {
+            return;
+        }
+
         const timestamp_t var_timestamp = var.get_modification_timestamp();
 
         /* this implies we have not seen the variable before.
@@ -1307,90 +2081,56 @@ class TracerState {
             return;
         }
 
-        /* if the modification timestamp of the variable is
-           greater than the creation timestamp of the promise,
-           then, that promise has identified a side effect */
+        /* If the most recent context that is responsible for this
+           side effect is a closure, then return. Currently, we only
+           care about promises directly responsible for side effects.
+           We don't return in case of specials and builtins because
+           they are more like operators in a programming language and
+           everything ultimately happens in them and returning on
+           encountering them will make it look like no promise has
+           caused a side effect. */
+        const int promise_index = stack.get_promise_index();
+
+        if (stack.find_closure_index(env) > promise_index) {
+            /* its normal for a function to mutate variables in its
+               own environment. this case is not interesting. */
+            return;
+        }
 
-        bool direct = true;
+        bool direct = stack.get_closure_count_above(promise_index) == 0;
 
-        ExecutionContextStack& stack = get_stack_();
+        DenotedValue* promise = stack.at(promise_index).get_promise();
 
-        for (auto iter = stack.rbegin(); iter != stack.rend(); ++iter) {
-            ExecutionContext& exec_ctxt = *iter;
-
-            /* If the most recent context that is responsible for this
-               side effect is a closure, then return. Currently, we only
-               care about promises directly responsible for side effects.
-               We don't return in case of specials and builtins because
-               they are more like operators in a programming language and
-               everything ultimately happens in them and returning on
-               encountering them will make it look like no promise has
-               caused a side effect. */
-
-            if (exec_ctxt.is_closure()) {
-                if (exec_ctxt.get_closure()->get_environment() == env) {
-                    /* its normal for a function to mutate variables in its
-                       own environment. this case is not interesting. */
-                    return;
-                } else {
-                    direct = false;
-                }
-            }
+        /* if the modification timestamp of the variable is
+           greater than the creation timestamp of the promise,
+           then, that promise has identified a side effect.
+           Otherwise, the promise observes a variable created
+           before it and there is nothing to record. */
+        if (promise->get_creation_timestamp() >= var_timestamp) {
+            return;
+        }
 
-            if (exec_ctxt.is_promise()) {
-                DenotedValue* promise = exec_ctxt.get_promise();
-
-                const SEXP prom_env = promise->get_environment();
-
-                if (prom_env == env) {
-                    if (promise->get_creation_timestamp() < var_timestamp) {
-                        add_side_effect_summary(false,
-                                                SideEffectMode::SameEnvironment,
-                                                direct,
-                                                promise,
-                                                var.get_name());
-                        promise->set_self_scope_observation(direct);
-                        direct = false;
-                        return;
-                    } else {
-                        /* return if the promise observes a variable in its
-                         * environment created before it. */
-                        return; // to remove
-                    }
-                } else if (is_parent_environment(env, prom_env)) {
-                    /* if this happens, promise is observing side effect
-                       in its lexically scoped environment. */
-                    if (promise->get_creation_timestamp() < var_timestamp) {
-                        add_side_effect_summary(
-                            false,
-                            SideEffectMode::LexicalEnvironment,
-                            direct,
-                            promise,
-                            var.get_name());
-                        promise->set_lexical_scope_observation(direct);
-                        direct = false;
-                        return;
-                    } else {
-                        return; // to remove
-                    }
-                } else {
-                    /* if this happens, promise is observing side effect
-                       in non lexically scoped environment */
-                    if (promise->get_creation_timestamp() < var_timestamp) {
-                        add_side_effect_summary(
-                            false,
-                            SideEffectMode::OtherEnvironment,
-                            direct,
-                            promise,
-                            var.get_name());
-                        promise->set_non_lexical_scope_observation(direct);
-                        direct = false;
-                        return;
-                    } else {
-                        return; // to remove
-                    }
-                }
-            }
+        const SEXP prom_env = promise->get_environment();
+
+        if (prom_env == env) {
+            record_side_effect_(
+                false, SideEffectMode::SameEnvironment, direct, promise, var);
+            promise->set_self_scope_observation(direct);
+        } else if (is_parent_environment(env, prom_env)) {
+            /* if this happens, promise is observing side effect
+               in its lexically scoped environment. */
+            record_side_effect_(false,
+                                SideEffectMode::LexicalEnvironment,
+                                direct,
+                                promise,
+                                var);
+            promise->set_lexical_scope_observation(direct);
+        } else {
+            /* if this happens, promise is observing side effect
+               in non lexically scoped environment */
+            record_side_effect_(
+                false, SideEffectMode::OtherEnvironment, direct, promise, var);
+            promise->set_non_lexical_scope_observation(direct);
         }
     }
 
@@ -1426,44 +2166,36 @@ class TracerState {
 
     eval_depth_t get_evaluation_depth(Call* call) {
         ExecutionContextStack& stack = get_stack_();
-        ExecutionContextStack::reverse_iterator iter;
         eval_depth_t eval_depth = {0, 0, 0, -1};
-        bool nesting = true;
-        bool call_found = false;
 
-        for (iter = stack.rbegin(); iter != stack.rend(); ++iter) {
-            ExecutionContext& exec_ctxt = *iter;
-
-            if (exec_ctxt.is_closure()) {
-                nesting = false;
-                if (exec_ctxt.get_call() == call) {
-                    call_found = true;
-                    break;
-                }
-                ++eval_depth.call_depth;
-
-            } else if (exec_ctxt.is_promise()) {
-                ++eval_depth.promise_depth;
-                if (nesting)
-                    ++eval_depth.nested_promise_depth;
-                DenotedValue* promise = exec_ctxt.get_promise();
-                if (eval_depth.forcing_actual_argument_position == -1 &&
-                    promise->is_argument() &&
-                    promise->get_last_argument()->get_call() == call) {
-                    eval_depth.forcing_actual_argument_position =
-                        promise->get_last_argument()
-                            ->get_actual_argument_position();
-                }
-            }
-        }
+        int call_index = stack.find_closure_index(call);
 
         // if this happens, it means we could not locate the call from which
         // this promise originated. This means that this is an escaped
         // promise.
-        if (iter == stack.rend() && !call_found) {
+        if (call_index == -1) {
             return ESCAPED_PROMISE_EVAL_DEPTH;
         }
 
+        eval_depth.call_depth = stack.get_closure_count_above(call_index);
+        eval_depth.promise_depth = stack.get_promise_count_above(call_index);
+        eval_depth.nested_promise_depth =
+            stack.get_promise_count_above(stack.get_closure_index());
+
+        /* only promise entries above the call are visited here */
+        for (int index = stack.get_promise_index(stack.size() - 1);
+             index > call_index;
+             index = stack.get_promise_index(index - 1)) {
+            DenotedValue* promise = stack.at(index).get_promise();
+            if (promise->is_argument() &&
+                promise->get_last_argument()->get_call() == call) {
+                eval_depth.forcing_actual_argument_position =
+                    promise->get_last_argument()
+                        ->get_actual_argument_position();
+                break;
+            }
+        }
+
         return eval_depth;
     }
 
@@ -1475,7 +2207,7 @@ class TracerState {
         return gc_cycle_;
     }
 
-    void add_side_effect_summary(bool side_effect_creator,
+    std::size_t add_side_effect_summary(bool side_effect_creator,
                                  SideEffectMode side_effect_mode,
                                  bool direct,
                                  DenotedValue* promise,
@@ -1508,7 +2240,7 @@ class TracerState {
                     side_effect_creator,
                     side_effect_mode,
                     direct)) {
-                return;
+                return i;
             }
         }
 
@@ -1523,8 +2255,65 @@ class TracerState {
                               side_effect_creator,
                               side_effect_mode,
                               direct));
+
+        return side_effect_summaries_.size() - 1;
+    }
+
+  private:
+    /* Repeated accesses to the same variable by the promise being forced
+       resolve to the same summary. They are remembered here so that the
+       summary path (expression serialization and the linear merge over
+       all summaries) runs once per (variable, promise) pair within a
+       single force. */
+    void record_side_effect_(bool side_effect_creator,
+                             SideEffectMode side_effect_mode,
+                             bool direct,
+                             DenotedValue* promise,
+                             const Variable& var) {
+        const Argument* argument =
+            promise->is_argument() ? promise->get_last_argument() : nullptr;
+
+        if (side_effect_memo_promise_ != promise ||
+            side_effect_memo_argument_ != argument) {
+            side_effect_memo_.clear();
+            side_effect_memo_promise_ = promise;
+            side_effect_memo_argument_ = argument;
+        }
+
+        const std::uint64_t key =
+            (static_cast<std::uint64_t>(var.get_id()) << 4) |
+            (static_cast<std::uint64_t>(to_underlying(side_effect_mode))
+             << 2) |
+            (static_cast<std::uint64_t>(side_effect_creator) << 1) |
+            static_cast<std::uint64_t>(direct);
+
+        auto iter = side_effect_memo_.find(key);
+
+        if (iter != side_effect_memo_.end()) {
+            side_effect_summaries_[iter->second].increment_side_effect_count();
+            return;
+        }
+
+        side_effect_memo_.insert({key,
+                                  add_side_effect_summary(side_effect_creator,
+                                                          side_effect_mode,
+                                                          direct,
+                                                          promise,
+                                                          var.get_name())});
     }
 
+    void reset_side_effect_memo_() {
+        side_effect_memo_.clear();
+        side_effect_memo_promise_ = nullptr;
+        side_effect_memo_argument_ = nullptr;
+    }
+
+    std::unordered_map<std::uint64_t, std::size_t> side_effect_memo_;
+    const DenotedValue* side_effect_memo_promise_;
+    const Argument* side_effect_memo_argument_;
+
+  public:
+
     void add_promise_gc_summary(DenotedValue* promise) {
         bool local = promise->is_local();
         bool forced = promise->get_force_count();
@@ -1601,8 +2390,13 @@ class TracerState {
         }
     }
 
-    tastr::ast::FunctionTypeNode*
-    get_type_declaration(const std::string& package_name,
+    std::size_t get_type_declaration_set_count() const {
+        return type_declaration_caches_.size();
+    }
+
+    const TypecheckProgram*
+    get_type_declaration(int declaration_set,
+                         const std::string& package_name,
                          const std::string& function_name) {
         if (package_name == "") {
             return nullptr;
@@ -1612,11 +2406,117 @@ class TracerState {
             return nullptr;
         }
 
-        return type_declaration_cache_.get_function_type(package_name,
-                                                         function_name);
+        return type_declaration_caches_[declaration_set]->get_function_type(
+            package_name, function_name);
+    }
+
+    /* Drops the loaded type declarations, they are loaded again from the
+       declaration files or their caches when the functions are next called.
+       The programs of the functions are dropped right away because the
+       caches destroy them. */
+    void reload_type_declarations() {
+        for (auto& type_declaration_cache: type_declaration_caches_) {
+            type_declaration_cache->reload();
+        }
+
+        ++type_declaration_generation_;
+
+        for (auto const& binding: function_cache_) {
+            binding.second->reset_type_declarations(
+                type_declaration_generation_, get_type_declaration_set_count());
+        }
+    }
+
+    /* the symbol a function is called by. Calls by other expressions are
+       keyed by R_NilValue and resolved by their name, a symbol is not
+       interned for them since that can allocate inside a probe. */
+    static SEXP get_function_symbol_(SEXP call) {
+        if (TYPEOF(call) == LANGSXP && TYPEOF(CAR(call)) == SYMSXP) {
+            return CAR(call);
+        }
+
+        return R_NilValue;
+    }
+
+    /* Once a function has a declaration in a set it keeps it, whatever
+       name it is called by later, until the type declarations are
+       reloaded. Calls by the symbol the function was resolved for last
+       return right away. */
+    void resolve_type_declaration_(Function* function,
+                                   SEXP function_symbol,
+                                   const std::string& function_name) {
+        if (function->is_type_declaration_resolved(
+                type_declaration_generation_, function_symbol)) {
+            return;
+        }
+
+        int set_count = get_type_declaration_set_count();
+
+        if (function->get_type_declaration_generation() !=
+            type_declaration_generation_) {
+            function->reset_type_declarations(type_declaration_generation_,
+                                              set_count);
+        } else if (function->has_valid_type_declarations()) {
+            function->set_type_declaration_resolved(function_symbol);
+            return;
+        }
+
+        const type_declarations_t* programs =
+            function->find_type_declarations(function_symbol, function_name);
+
+        if (programs == nullptr) {
+            type_declarations_t lookups(set_count, nullptr);
+
+            for (int declaration_set = 0; declaration_set < set_count;
+                 ++declaration_set) {
+                lookups[declaration_set] = get_type_declaration(
+                    declaration_set, function->get_namespace(), function_name);
+            }
+
+            programs = &function->add_type_declarations(
+                function_symbol, function_name, lookups);
+        }
+
+        for (int declaration_set = 0; declaration_set < set_count;
+             ++declaration_set) {
+            const TypecheckProgram* program = (*programs)[declaration_set];
+
+            if (program != nullptr &&
+                function->has_invalid_type_declaration(declaration_set)) {
+                function->set_type_declaration(declaration_set, program);
+            }
+        }
+
+        function->set_type_declaration_resolved(function_symbol);
+    }
+
+    /* Each distinct descriptor is written once to the value_shapes table,
+       typechecking rows refer to it by id. Values without a captured shape
+       have id -1. */
+    int get_value_shape_id(const ValueShape* shape) {
+        if (value_shapes_data_table_ == nullptr || shape == nullptr) {
+            return -1;
+        }
+
+        const std::string descriptor = shape->to_descriptor();
+
+        auto iter = value_shape_ids_.find(descriptor);
+
+        if (iter != value_shape_ids_.end()) {
+            return iter->second;
+        }
+
+        int value_shape_id = value_shape_ids_.size();
+        value_shape_ids_.insert({descriptor, value_shape_id});
+        value_shapes_data_table_->write_row(value_shape_id, descriptor);
+        return value_shape_id;
     }
 
-    void add_typechecking_result(const function_id_t& function_id,
+    /* saturated checks are only counted by the shape they were skipped
+       for, they are written to the typechecking_saturation table when the
+       function is destroyed. */
+    void add_typechecking_result(Function* function,
+                                 int declaration_set,
                                  call_id_t call_id,
                                  int formal_parameter_position,
                                  int actual_argument_position,
@@ -1625,24 +2525,43 @@ class TracerState {
                                  bool forced,
                                  sexptype_t outer_type,
                                  sexptype_t inner_type,
-                                 Typecheck match_result) {
-        typechecking_data_table_->write_row(function_id,
-                                            call_id,
-                                            formal_parameter_position,
-                                            actual_argument_position,
-                                            default_argument,
-                                            dot_dot_dot,
-                                            forced,
-                                            sexptype_to_string(outer_type),
-                                            sexptype_to_string(inner_type),
-                                            to_string(match_result));
+                                 Typecheck match_result,
+                                 value_shape_t typecheck_shape,
+                                 int value_shape_id) {
+        if (match_result == Typecheck::Saturated) {
+            function->add_skipped_typecheck(
+                declaration_set, formal_parameter_position, typecheck_shape);
+            return;
+        }
+
+        function
+            ->get_typecheck_saturation(declaration_set,
+                                       formal_parameter_position)
+            .record(typecheck_shape,
+                    match_result,
+                    typecheck_budget_.saturation_threshold);
+
+        write_event_row_(typechecking_data_table_,
+                         typechecking_aggregate_table_,
+                         function->get_id(),
+                         call_id,
+                         declaration_set,
+                         formal_parameter_position,
+                         actual_argument_position,
+                         default_argument,
+                         dot_dot_dot,
+                         forced,
+                         sexptype_to_string(outer_type),
+                         sexptype_to_string(inner_type),
+                         to_string(match_result),
+                         value_shape_id);
     }
 
   private:
     call_id_t call_id_counter_;
     std::vector<unsigned int> object_count_;
     std::vector<std::pair<lifecycle_t, int>> lifecycle_summary_;
-    std::vector<unsigned long int> event_counter_;
+    std::uint64_t event_counter_[to_underlying(Event::COUNT)];
     gc_cycle_t gc_cycle_;
     bool argument_list_creation_mode_;
     std::vector<SideEffectSummary> side_effect_summaries_;
@@ -1650,7 +2569,13 @@ class TracerState {
         context_sensitive_lookup_summaries_;
     std::vector<PromiseGcSummary> promise_gc_summaries_;
     std::vector<PromiseLifecycleSummary> promise_lifecycle_summaries_;
-    TypeDeclarationCache type_declaration_cache_;
+    const std::vector<std::string> type_declaration_dirpaths_;
+    std::vector<std::unique_ptr<TypeDeclarationCache>> type_declaration_caches_;
+    int type_declaration_generation_;
+    std::vector<LatencyHistogram> probe_latencies_;
+    std::uint64_t probe_entry_ticks_;
+    const std::uint64_t calibration_ticks_;
+    const std::chrono::steady_clock::time_point calibration_time_;
 };
 
 #endif /* TYPETESTERDYNTRACER_TRACER_STATE_H */
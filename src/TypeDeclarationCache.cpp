@@ -0,0 +1,355 @@
+#include "TypeDeclarationCache.h"
+
+#include "utilities.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* 'TTDC' */
+static const std::uint32_t TYPE_DECLARATION_CACHE_MAGIC = 0x43445454;
+
+TypeDeclarationCache::package_t::~package_t() {
+    if (mapping != nullptr) {
+        munmap(mapping, mapping_size);
+    }
+}
+
+TypeDeclarationCache::TypeDeclarationCache(
+    const fs::path& type_declaration_dirpath)
+    : type_declaration_dirpath_(fs::canonical(type_declaration_dirpath)) {
+    if (!fs::is_directory(type_declaration_dirpath_)) {
+        dyntrace_log_error("Unable to find type declaration directory '%s'",
+                           type_declaration_dirpath_.c_str());
+    }
+
+    cache_dirpath_ = type_declaration_dirpath_.string() + ".cache";
+}
+
+const TypecheckProgram*
+TypeDeclarationCache::get_function_type(const std::string& package_name,
+                                        const std::string& function_name) {
+    auto package_iter = packages_.find(package_name);
+
+    package_t& package = package_iter == packages_.end()
+                             ? load_package_(package_name)
+                             : *package_iter->second;
+
+    if (!pending_packages_.empty()) {
+        auto pending_iter = pending_packages_.find(package_name);
+
+        if (pending_iter != pending_packages_.end()) {
+            /* rethrows parse errors on the R thread */
+            pending_iter->second.get();
+            pending_packages_.erase(pending_iter);
+        }
+    }
+
+    auto program_iter = package.programs.find(function_name);
+
+    if (program_iter != package.programs.end()) {
+        return program_iter->second.get();
+    }
+
+    auto serialized_iter = package.serialized_programs.find(function_name);
+
+    if (serialized_iter == package.serialized_programs.end()) {
+        return nullptr;
+    }
+
+    const TypecheckProgram* program =
+        package.programs
+            .insert({function_name,
+                     std::make_unique<TypecheckProgram>(
+                         serialized_iter->second.first,
+                         serialized_iter->second.second)})
+            .first->second.get();
+
+    package.serialized_programs.erase(serialized_iter);
+
+    return program;
+}
+
+void TypeDeclarationCache::reload() {
+    for (auto& binding: pending_packages_) {
+        binding.second.wait();
+    }
+
+    pending_packages_.clear();
+    packages_.clear();
+}
+
+void TypeDeclarationCache::preload(const std::vector<std::string>& package_names,
+                                   int thread_count) {
+    if (package_names.empty() || thread_count < 1) {
+        return;
+    }
+
+    if (!loader_pool_) {
+        loader_pool_ = std::make_unique<ThreadPool>(thread_count);
+    }
+
+    for (const std::string& package_name: package_names) {
+        if (packages_.count(package_name) != 0) {
+            continue;
+        }
+
+        package_t& package =
+            *packages_.insert({package_name, std::make_unique<package_t>()})
+                 .first->second;
+
+        pending_packages_.insert(
+            {package_name, loader_pool_->submit([this, package_name, &package] {
+                 read_package_(package_name, package);
+             })});
+    }
+}
+
+TypeDeclarationCache::package_t&
+TypeDeclarationCache::load_package_(const std::string& package_name) {
+    package_t& package =
+        *packages_.insert({package_name, std::make_unique<package_t>()})
+             .first->second;
+
+    read_package_(package_name, package);
+
+    return package;
+}
+
+void TypeDeclarationCache::read_package_(const std::string& package_name,
+                                         package_t& package) const {
+    const fs::path package_filepath = type_declaration_dirpath_ / package_name;
+    const fs::path cache_filepath = cache_dirpath_ / package_name;
+
+    std::error_code error;
+
+    if (!fs::is_regular_file(package_filepath, error)) {
+        return;
+    }
+
+    /* cached programs have no type to cross-check them with, so the
+       cross-checking build always parses the declarations */
+#ifdef TYPECHECK_PROGRAM_CROSSCHECK
+    const bool mapped = false;
+#else
+    const bool mapped = map_cache_(package_filepath, cache_filepath, package);
+#endif
+
+    if (!mapped) {
+        {
+            std::lock_guard<std::mutex> lock(parse_mutex_);
+            import_type_declarations_(package_filepath, package);
+        }
+        write_cache_(package_filepath, cache_filepath, package);
+    }
+}
+
+/* The cache layout is the header, the hash of the declaration file, the
+   number of functions and, for each function, its name and its serialized
+   program, all prefixed with their sizes. */
+bool TypeDeclarationCache::map_cache_(const fs::path& package_filepath,
+                                      const fs::path& cache_filepath,
+                                      package_t& package) const {
+    int fd = open(cache_filepath.c_str(), O_RDONLY);
+
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat cache_stat;
+
+    if (fstat(fd, &cache_stat) != 0 ||
+        cache_stat.st_size < static_cast<off_t>(sizeof(cache_header_t))) {
+        close(fd);
+        return false;
+    }
+
+    std::size_t size = cache_stat.st_size;
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    const char* data = static_cast<const char*>(mapping);
+    const char* end = data + size;
+    std::size_t offset = 0;
+
+    auto read_size = [&](std::uint32_t& value) {
+        if (offset + sizeof(value) > size) {
+            return false;
+        }
+        std::memcpy(&value, data + offset, sizeof(value));
+        offset += sizeof(value);
+        return offset + value <= size;
+    };
+
+    cache_header_t header;
+    cache_header_t current;
+    std::uint32_t hash_length = 0;
+
+    std::memcpy(&header, data, sizeof(header));
+    offset = sizeof(header);
+
+    bool valid = header.magic == TYPE_DECLARATION_CACHE_MAGIC &&
+                 header.version == TYPE_DECLARATION_CACHE_VERSION &&
+                 get_file_status_(package_filepath, current) &&
+                 read_size(hash_length);
+
+    /* a touched but unchanged declaration file keeps its cache */
+    if (valid && (header.modification_time != current.modification_time ||
+                  header.size != current.size)) {
+        valid = std::string(data + offset, hash_length) ==
+                hash_file_(package_filepath);
+    }
+
+    offset += hash_length;
+
+    std::uint32_t function_count = 0;
+
+    if (valid && offset + sizeof(function_count) <= size) {
+        std::memcpy(&function_count, data + offset, sizeof(function_count));
+        offset += sizeof(function_count);
+    } else {
+        valid = false;
+    }
+
+    for (std::uint32_t i = 0; valid && i < function_count; ++i) {
+        std::uint32_t name_length = 0;
+        std::uint32_t program_size = 0;
+
+        if (!read_size(name_length)) {
+            valid = false;
+            break;
+        }
+
+        std::string name(data + offset, name_length);
+        offset += name_length;
+
+        if (!read_size(program_size)) {
+            valid = false;
+            break;
+        }
+
+        package.serialized_programs.insert(
+            {name, {data + offset, program_size}});
+        offset += program_size;
+    }
+
+    if (!valid || data + offset != end) {
+        package.serialized_programs.clear();
+        munmap(mapping, size);
+        return false;
+    }
+
+    package.mapping = mapping;
+    package.mapping_size = size;
+
+    return true;
+}
+
+/* Declarations are compiled straight from the parse result, only function
+   types can be looked up. */
+void TypeDeclarationCache::import_type_declarations_(
+    const fs::path& package_filepath,
+    package_t& package) const {
+    tastr::parser::ParseResult result(
+        tastr::parser::parse_file(package_filepath));
+
+    for (const std::unique_ptr<tastr::ast::TypeDeclarationNode>& decl:
+         result.get_top_level_node()->get_type_declarations()) {
+        const tastr::ast::TypeNode& type = decl->get_type();
+
+        if (type.is_function_type_node()) {
+            package.programs.insert(
+                {decl->get_identifier().get_name(),
+                 std::make_unique<TypecheckProgram>(
+                     tastr::ast::as<tastr::ast::FunctionTypeNode>(type))});
+        }
+    }
+}
+
+/* The cache is written to a temporary file which is renamed over the old
+   cache, so concurrent runs never see a partially written cache. Failures
+   only mean that the next run parses the declarations again. */
+void TypeDeclarationCache::write_cache_(const fs::path& package_filepath,
+                                        const fs::path& cache_filepath,
+                                        const package_t& package) const {
+    cache_header_t header;
+
+    if (!get_file_status_(package_filepath, header)) {
+        return;
+    }
+
+    header.magic = TYPE_DECLARATION_CACHE_MAGIC;
+    header.version = TYPE_DECLARATION_CACHE_VERSION;
+
+    std::string buffer(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    auto write_size = [&buffer](std::uint32_t value) {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+
+    std::string hash = hash_file_(package_filepath);
+    write_size(hash.size());
+    buffer.append(hash);
+
+    write_size(package.programs.size());
+
+    std::string program_buffer;
+
+    for (const auto& binding: package.programs) {
+        write_size(binding.first.size());
+        buffer.append(binding.first);
+
+        program_buffer.clear();
+        binding.second->serialize(program_buffer);
+        write_size(program_buffer.size());
+        buffer.append(program_buffer);
+    }
+
+    std::error_code error;
+    fs::create_directories(cache_dirpath_, error);
+
+    fs::path temporary_filepath = cache_filepath.string() + ".tmp." +
+                                  std::to_string(getpid());
+
+    std::ofstream file(temporary_filepath, std::ios::binary | std::ios::trunc);
+    file.write(buffer.data(), buffer.size());
+    file.close();
+
+    if (!file) {
+        fs::remove(temporary_filepath, error);
+        return;
+    }
+
+    fs::rename(temporary_filepath, cache_filepath, error);
+
+    if (error) {
+        fs::remove(temporary_filepath, error);
+    }
+}
+
+bool TypeDeclarationCache::get_file_status_(const fs::path& filepath,
+                                            cache_header_t& header) {
+    struct stat file_stat;
+
+    if (stat(filepath.c_str(), &file_stat) != 0) {
+        return false;
+    }
+
+    header.modification_time =
+        static_cast<std::int64_t>(file_stat.st_mtim.tv_sec) * 1000000000 +
+        file_stat.st_mtim.tv_nsec;
+    header.size = file_stat.st_size;
+
+    return true;
+}
+
+std::string TypeDeclarationCache::hash_file_(const fs::path& filepath) {
+    std::ifstream file(filepath, std::ios::binary);
+    return compute_hash(readfile(file).c_str());
+}
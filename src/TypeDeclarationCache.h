@@ -1,6 +1,9 @@
 #ifndef TYPETESTERDYNTRACER_TYPE_DECLARATION_CACHE_H
 #define TYPETESTERDYNTRACER_TYPE_DECLARATION_CACHE_H
 
+#include "ThreadPool.h"
+#include "TypecheckProgram.h"
+
 #include <filesystem>
 #include <memory>
 #include <tastr/ast/ast.hpp>
@@ -8,67 +11,87 @@
 
 namespace fs = std::filesystem;
 
+/* Type declarations of each package are compiled to typecheck programs
+   when the package is first needed. The compiled programs are persisted
+   in a binary cache in the sibling directory <type_declaration_dirpath>.cache
+   and later runs memory map the cache instead of parsing the declarations,
+   as long as the declaration file has the same modification time and size,
+   or the same hash. Programs are deserialized from the mapping when they
+   are looked up. Packages can also be loaded ahead of time on background
+   threads, lookups into such a package wait until it is loaded. */
 class TypeDeclarationCache {
   public:
-    explicit TypeDeclarationCache(const fs::path& type_declaration_dirpath)
-        : type_declaration_dirpath_(fs::canonical(type_declaration_dirpath)) {
-        if (!fs::is_directory(type_declaration_dirpath_)) {
-            dyntrace_log_error("Unable to find type declaration directory '%s'",
-                               type_declaration_dirpath_.c_str());
-        }
-    }
+    explicit TypeDeclarationCache(const fs::path& type_declaration_dirpath);
 
     ~TypeDeclarationCache() = default;
 
-    tastr::ast::FunctionTypeNode*
-    get_function_type(const std::string& package_name,
-                      const std::string& function_name) {
-        const fs::path package_path = type_declaration_dirpath_ / package_name;
+    const TypecheckProgram* get_function_type(const std::string& package_name,
+                                              const std::string& function_name);
 
-        auto package = packages_.find(package_name);
+    /* drops all loaded packages so that they are loaded again from the
+       declaration files or their caches, the programs of the dropped
+       packages are destroyed */
+    void reload();
 
-        if (package == packages_.end()) {
-            package = packages_
-                          .insert({package_name,
-                                   import_type_declarations(package_path)})
-                          .first;
-        }
+    /* starts loading the packages on thread_count background threads */
+    void preload(const std::vector<std::string>& package_names,
+                 int thread_count);
 
-        auto type_iter = package->second.find(function_name);
-        if (type_iter == package->second.end()) {
-            return nullptr;
-        }
-        tastr::ast::TypeNode* node = type_iter->second.get();
-        if (node->is_function_type_node()) {
-            return static_cast<tastr::ast::FunctionTypeNode*>(node);
+  private:
+    struct package_t {
+        package_t(): mapping(nullptr), mapping_size(0) {
         }
 
-        return nullptr;
-    }
+        ~package_t();
 
-    std::unordered_map<std::string, tastr::ast::TypeNodeUPtr>
-    import_type_declarations(
-        const fs::path& package_type_declaration_filepath) {
-        tastr::parser::ParseResult result(
-            tastr::parser::parse_file(package_type_declaration_filepath));
+        std::unordered_map<std::string, std::unique_ptr<TypecheckProgram>>
+            programs;
+        std::unordered_map<std::string, std::pair<const char*, std::size_t>>
+            serialized_programs;
+        void* mapping;
+        std::size_t mapping_size;
+    };
 
-        std::unordered_map<std::string, tastr::ast::TypeNodeUPtr> package_map;
+    struct cache_header_t {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::int64_t modification_time;
+        std::uint64_t size;
+    };
 
-        for (const std::unique_ptr<tastr::ast::TypeDeclarationNode>& decl:
-             result.get_top_level_node()->get_type_declarations()) {
-            std::string name(decl->get_identifier().get_name());
-            package_map.insert(std::make_pair(name, decl->get_type().clone()));
-        }
-        return package_map;
-    }
+    package_t& load_package_(const std::string& package_name);
 
-  private:
-    std::unordered_map<
-        std::string,
-        std::unordered_map<std::string, tastr::ast::TypeNodeUPtr>>
-        packages_;
+    /* safe to call off the R thread, it only touches package */
+    void read_package_(const std::string& package_name,
+                       package_t& package) const;
+
+    bool map_cache_(const fs::path& package_filepath,
+                    const fs::path& cache_filepath,
+                    package_t& package) const;
+
+    void import_type_declarations_(const fs::path& package_filepath,
+                                   package_t& package) const;
+
+    void write_cache_(const fs::path& package_filepath,
+                      const fs::path& cache_filepath,
+                      const package_t& package) const;
+
+    static bool get_file_status_(const fs::path& filepath,
+                                 cache_header_t& header);
+
+    static std::string hash_file_(const fs::path& filepath);
+
+    std::unordered_map<std::string, std::unique_ptr<package_t>> packages_;
 
     fs::path type_declaration_dirpath_;
+    fs::path cache_dirpath_;
+
+    /* the tastr parser is not known to be reentrant */
+    mutable std::mutex parse_mutex_;
+    std::unordered_map<std::string, std::future<void>> pending_packages_;
+    /* declared last so that the loaders are joined before the packages
+       they load into are destroyed */
+    std::unique_ptr<ThreadPool> loader_pool_;
 };
 
 #endif /* TYPETESTERDYNTRACER_TYPE_DECLARATION_CACHE_H */
@@ -0,0 +1,669 @@
+#include "TypecheckProgram.h"
+
+#include <cstring>
+
+using tastr::ast::AScalarTypeNode;
+using tastr::ast::GroupTypeNode;
+using tastr::ast::ListTypeNode;
+using tastr::ast::NAScalarTypeNode;
+using tastr::ast::NullableTypeNode;
+using tastr::ast::ScalarTypeNode;
+using tastr::ast::StructTypeNode;
+using tastr::ast::TagTypePairNode;
+using tastr::ast::TypeNode;
+using tastr::ast::UnionTypeNode;
+using tastr::ast::VectorTypeNode;
+
+static std::uint32_t sexptype_bit(SEXPTYPE sexptype) {
+    return static_cast<std::uint32_t>(1) << sexptype;
+}
+
+/* sexptypes which satisfies handles in the default case, these are the only
+   ones matched by the any type. */
+static std::uint32_t default_sexptype_mask() {
+    const SEXPTYPE handled[] = {
+        NILSXP,     LGLSXP,     INTSXP,    RAWSXP,    REALSXP,    CPLXSXP,
+        STRSXP,     S4SXP,      SYMSXP,    LISTSXP,   ENVSXP,     LANGSXP,
+        EXPRSXP,    VECSXP,     EXTPTRSXP, BCODESXP,  WEAKREFSXP, DOTSXP,
+        CLOSXP,     SPECIALSXP, BUILTINSXP, PROMSXP,  ANYSXP,     CHARSXP};
+
+    std::uint32_t mask = ~static_cast<std::uint32_t>(0);
+
+    for (SEXPTYPE sexptype: handled) {
+        mask &= ~sexptype_bit(sexptype);
+    }
+
+    return mask;
+}
+
+static SEXPTYPE a_scalar_sexptype(const AScalarTypeNode& node) {
+    if (node.is_logical_a_scalar_type_node()) {
+        return LGLSXP;
+    }
+    if (node.is_integer_a_scalar_type_node()) {
+        return INTSXP;
+    }
+    if (node.is_double_a_scalar_type_node()) {
+        return REALSXP;
+    }
+    if (node.is_complex_a_scalar_type_node()) {
+        return CPLXSXP;
+    }
+    if (node.is_character_a_scalar_type_node()) {
+        return STRSXP;
+    }
+    if (node.is_raw_a_scalar_type_node()) {
+        return RAWSXP;
+    }
+    return NILSXP;
+}
+
+TypecheckProgram::TypecheckProgram(const tastr::ast::FunctionTypeNode& type) {
+    const auto& parameter_types = type.get_parameter_types();
+
+    for (std::size_t i = 0; i < parameter_types.size(); ++i) {
+        const TypeNode& parameter_type = *parameter_types.at(i).get();
+        parameter_types_.push_back(compile_(parameter_type));
+        parameter_varargs_.push_back(parameter_type.is_vararg_type_node());
+    }
+
+    return_type_ = compile_(type.get_return_type());
+
+    initialize_();
+
+#ifdef TYPECHECK_PROGRAM_CROSSCHECK
+    type_ = type.clone();
+#endif
+}
+
+template <typename T>
+static void write_value(std::string& buffer, T value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void write_string(std::string& buffer, const std::string& value) {
+    write_value<std::uint32_t>(buffer, value.size());
+    buffer.append(value);
+}
+
+/* reads the values written by serialize in the same order */
+class ProgramReader {
+  public:
+    ProgramReader(const char* data, std::size_t size)
+        : data_(data), size_(size), offset_(0) {
+    }
+
+    template <typename T>
+    T read_value() {
+        T value;
+        std::memcpy(&value, advance_(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    std::string read_string() {
+        std::uint32_t length = read_value<std::uint32_t>();
+        return std::string(advance_(length), length);
+    }
+
+  private:
+    const char* advance_(std::size_t count) {
+        if (offset_ + count > size_) {
+            dyntrace_log_error("truncated typecheck program");
+        }
+        const char* position = data_ + offset_;
+        offset_ += count;
+        return position;
+    }
+
+    const char* data_;
+    std::size_t size_;
+    std::size_t offset_;
+};
+
+TypecheckProgram::TypecheckProgram(const char* data, std::size_t size) {
+    ProgramReader reader(data, size);
+
+    types_.resize(reader.read_value<std::uint32_t>());
+
+    for (compiled_type_t& type: types_) {
+        type.match_mask = reader.read_value<std::uint32_t>();
+        for (std::uint8_t& flags: type.atomic_flags) {
+            flags = reader.read_value<std::uint8_t>();
+        }
+        type.aggregates.resize(reader.read_value<std::uint32_t>());
+        for (int& aggregate: type.aggregates) {
+            aggregate = reader.read_value<std::int32_t>();
+        }
+    }
+
+    aggregates_.resize(reader.read_value<std::uint32_t>());
+
+    for (compiled_aggregate_t& aggregate: aggregates_) {
+        aggregate.is_struct = reader.read_value<std::uint8_t>();
+        aggregate.element_types.resize(reader.read_value<std::uint32_t>());
+        for (int& element_type: aggregate.element_types) {
+            element_type = reader.read_value<std::int32_t>();
+        }
+        if (aggregate.is_struct) {
+            for (std::size_t i = 0; i < aggregate.element_types.size(); ++i) {
+                aggregate.tags.push_back(reader.read_string());
+            }
+        }
+    }
+
+    parameter_types_.resize(reader.read_value<std::uint32_t>());
+
+    for (std::size_t i = 0; i < parameter_types_.size(); ++i) {
+        parameter_types_[i] = reader.read_value<std::int32_t>();
+        parameter_varargs_.push_back(reader.read_value<std::uint8_t>());
+    }
+
+    return_type_ = reader.read_value<std::int32_t>();
+
+    initialize_();
+}
+
+/* types are compiled before the element types of their aggregates, so the
+   masks are accumulated from the last type to the first. */
+void TypecheckProgram::initialize_() {
+    na_sexptype_masks_.assign(types_.size(), 0);
+
+    for (std::size_t index = types_.size(); index-- > 0;) {
+        const compiled_type_t& type = types_[index];
+        std::uint32_t mask = 0;
+
+        for (int sexptype = 0; sexptype < SEXPTYPE_COUNT; ++sexptype) {
+            std::uint8_t flags = type.atomic_flags[sexptype];
+
+            if (!(type.match_mask & sexptype_bit(sexptype)) &&
+                (flags & (SCALAR | VECTOR)) && !(flags & VECTOR_NA_ALLOWED)) {
+                mask |= sexptype_bit(sexptype);
+            }
+        }
+
+        for (int aggregate: type.aggregates) {
+            for (int element_type: aggregates_[aggregate].element_types) {
+                mask |= na_sexptype_masks_[element_type];
+            }
+        }
+
+        na_sexptype_masks_[index] = mask;
+    }
+
+    shape_cache_.resize(parameter_types_.size() * SHAPE_CACHE_SIZE,
+                        shape_cache_entry_t{UNDEFINED_VALUE_SHAPE,
+                                            Typecheck::Undefined,
+                                            std::string()});
+}
+
+void TypecheckProgram::serialize(std::string& buffer) const {
+    write_value<std::uint32_t>(buffer, types_.size());
+
+    for (const compiled_type_t& type: types_) {
+        write_value<std::uint32_t>(buffer, type.match_mask);
+        for (std::uint8_t flags: type.atomic_flags) {
+            write_value<std::uint8_t>(buffer, flags);
+        }
+        write_value<std::uint32_t>(buffer, type.aggregates.size());
+        for (int aggregate: type.aggregates) {
+            write_value<std::int32_t>(buffer, aggregate);
+        }
+    }
+
+    write_value<std::uint32_t>(buffer, aggregates_.size());
+
+    for (const compiled_aggregate_t& aggregate: aggregates_) {
+        write_value<std::uint8_t>(buffer, aggregate.is_struct);
+        write_value<std::uint32_t>(buffer, aggregate.element_types.size());
+        for (int element_type: aggregate.element_types) {
+            write_value<std::int32_t>(buffer, element_type);
+        }
+        for (const std::string& tag: aggregate.tags) {
+            write_string(buffer, tag);
+        }
+    }
+
+    write_value<std::uint32_t>(buffer, parameter_types_.size());
+
+    for (std::size_t i = 0; i < parameter_types_.size(); ++i) {
+        write_value<std::int32_t>(buffer, parameter_types_[i]);
+        write_value<std::uint8_t>(buffer, parameter_varargs_[i]);
+    }
+
+    write_value<std::int32_t>(buffer, return_type_);
+}
+
+TypecheckProgram::~TypecheckProgram() {
+    for (const compiled_aggregate_t& aggregate: aggregates_) {
+        for (SEXP tag: aggregate.tag_chars) {
+            R_ReleaseObject(tag);
+        }
+    }
+}
+
+int TypecheckProgram::compile_(const TypeNode& type) {
+    int index = types_.size();
+    types_.push_back(compiled_type_t{0, {0}, {}});
+    add_alternative_(index, type);
+    return index;
+}
+
+void TypecheckProgram::add_alternative_(int index, const TypeNode& type) {
+    if (type.is_union_type_node()) {
+        const UnionTypeNode& union_type = tastr::ast::as<UnionTypeNode>(type);
+        add_alternative_(index, union_type.get_first_type());
+        add_alternative_(index, union_type.get_second_type());
+        return;
+    }
+
+    if (type.is_group_type_node()) {
+        const GroupTypeNode& group_type = tastr::ast::as<GroupTypeNode>(type);
+        add_alternative_(index, group_type.get_inner_type());
+        return;
+    }
+
+    /* a nullable type matches NULL and everything its inner type matches */
+    if (type.is_nullable_type_node()) {
+        const NullableTypeNode& nullable_type =
+            tastr::ast::as<NullableTypeNode>(type);
+        types_[index].match_mask |= sexptype_bit(NILSXP);
+        add_alternative_(index, nullable_type.get_inner_type());
+        return;
+    }
+
+    std::uint32_t mask = 0;
+
+    if (type.is_null_type_node()) {
+        mask |= sexptype_bit(NILSXP);
+    }
+    if (type.is_any_type_node()) {
+        mask |= default_sexptype_mask();
+    }
+    if (type.is_s4_type_node()) {
+        mask |= sexptype_bit(S4SXP);
+    }
+    if (type.is_symbol_type_node()) {
+        mask |= sexptype_bit(SYMSXP);
+    }
+    if (type.is_pairlist_type_node()) {
+        mask |= sexptype_bit(LISTSXP);
+    }
+    if (type.is_environment_type_node()) {
+        mask |= sexptype_bit(ENVSXP);
+    }
+    if (type.is_language_type_node()) {
+        mask |= sexptype_bit(LANGSXP);
+    }
+    if (type.is_expression_type_node()) {
+        mask |= sexptype_bit(EXPRSXP);
+    }
+    if (type.is_external_pointer_type_node()) {
+        mask |= sexptype_bit(EXTPTRSXP);
+    }
+    if (type.is_bytecode_type_node()) {
+        mask |= sexptype_bit(BCODESXP);
+    }
+    if (type.is_weak_reference_type_node()) {
+        mask |= sexptype_bit(WEAKREFSXP);
+    }
+    if (type.is_vararg_type_node()) {
+        mask |= sexptype_bit(DOTSXP);
+    }
+
+    types_[index].match_mask |= mask;
+
+    if (type.is_scalar_type_node() || type.is_vector_type_node()) {
+        bool vector = type.is_vector_type_node();
+        const ScalarTypeNode& scalar_type =
+            vector ? tastr::ast::as<VectorTypeNode>(type).get_scalar_type()
+                   : tastr::ast::as<ScalarTypeNode>(type);
+        bool na_allowed = scalar_type.is_na_scalar_type_node();
+        SEXPTYPE sexptype = a_scalar_sexptype(
+            na_allowed ? tastr::ast::as<NAScalarTypeNode>(scalar_type)
+                             .get_a_scalar_type()
+                       : tastr::ast::as<AScalarTypeNode>(scalar_type));
+
+        if (sexptype != NILSXP) {
+            types_[index].atomic_flags[sexptype] |=
+                vector ? (na_allowed ? VECTOR_NA_ALLOWED : VECTOR)
+                       : (na_allowed ? SCALAR_NA_ALLOWED : SCALAR);
+        }
+    }
+
+    if (type.is_list_type_node()) {
+        const auto& element_types =
+            tastr::ast::as<ListTypeNode>(type).get_element_types();
+        compiled_aggregate_t aggregate{false, {}, {}, {}};
+
+        for (std::size_t i = 0; i < element_types.size(); ++i) {
+            aggregate.element_types.push_back(
+                compile_(*element_types.at(i).get()));
+        }
+
+        types_[index].aggregates.push_back(aggregates_.size());
+        aggregates_.push_back(std::move(aggregate));
+    }
+
+    if (type.is_struct_type_node()) {
+        const auto& element_types =
+            tastr::ast::as<StructTypeNode>(type).get_element_types();
+        compiled_aggregate_t aggregate{true, {}, {}, {}};
+
+        for (std::size_t i = 0; i < element_types.size(); ++i) {
+            const TagTypePairNode& node(*element_types.at(i).get());
+            aggregate.tags.push_back(node.get_identifier().get_name());
+            aggregate.element_types.push_back(compile_(node.get_type()));
+        }
+
+        types_[index].aggregates.push_back(aggregates_.size());
+        aggregates_.push_back(std::move(aggregate));
+    }
+}
+
+bool TypecheckProgram::is_shape_independent_(SEXP value, int index) const {
+    const compiled_type_t& type = types_[index];
+    SEXPTYPE sexptype = TYPEOF(value);
+
+    return (type.match_mask & sexptype_bit(sexptype)) ||
+           (type.atomic_flags[sexptype] == 0 &&
+            (sexptype != VECSXP || type.aggregates.empty()));
+}
+
+Typecheck TypecheckProgram::satisfies_parameter(
+    SEXP value,
+    int formal_parameter_position,
+    value_shape_t shape,
+    const std::string& shape_key) const {
+    int index = parameter_types_.at(formal_parameter_position);
+
+    if (shape == UNDEFINED_VALUE_SHAPE) {
+        return crosscheck_(
+            value, formal_parameter_position, satisfies_(value, index, 0));
+    }
+
+    shape_cache_entry_t& entry =
+        shape_cache_[formal_parameter_position * SHAPE_CACHE_SIZE +
+                     (shape ^ (shape >> 8)) % SHAPE_CACHE_SIZE];
+
+    /* shapes of lists are hashes */
+    if (entry.shape == shape &&
+        (is_exact_value_shape(shape) || entry.key == shape_key)) {
+        return crosscheck_(value, formal_parameter_position, entry.result);
+    }
+
+    Typecheck result = is_exact_value_shape(shape)
+                           ? satisfies_shape_(shape, index)
+                           : satisfies_(value, index, 0);
+
+    /* sampled elements differ between checks of the same shape */
+    if (result != Typecheck::Partial) {
+        entry.shape = shape;
+        entry.result = result;
+        entry.key = shape_key;
+    }
+
+    return crosscheck_(value, formal_parameter_position, result);
+}
+
+#ifdef TYPECHECK_PROGRAM_CROSSCHECK
+/* sampled elements differ between the two checks, so they are only
+   compared when the elements are not sampled */
+Typecheck TypecheckProgram::crosscheck_(SEXP value,
+                                        int formal_parameter_position,
+                                        Typecheck result) const {
+    if (!type_ || get_typecheck_budget().sampling) {
+        return result;
+    }
+
+    const tastr::ast::FunctionTypeNode& function_type =
+        tastr::ast::as<tastr::ast::FunctionTypeNode>(*type_);
+    const TypeNode& type =
+        formal_parameter_position == -1
+            ? function_type.get_return_type()
+            : *function_type.get_parameter_types()
+                   .at(formal_parameter_position)
+                   .get();
+    Typecheck expected = satisfies(value, type);
+
+    if (result != expected) {
+        dyntrace_log_error(
+            "typecheck program returned %s instead of %s for a %s value at "
+            "position %d",
+            to_string(result).c_str(),
+            to_string(expected).c_str(),
+            type2char(TYPEOF(value)),
+            formal_parameter_position);
+    }
+
+    return result;
+}
+#endif
+
+bool TypecheckProgram::allows_na_(std::uint8_t flags, bool scalar) {
+    return (flags & VECTOR_NA_ALLOWED) ||
+           (scalar && (flags & SCALAR_NA_ALLOWED));
+}
+
+bool TypecheckProgram::allows_no_na_(std::uint8_t flags, bool scalar) {
+    return (flags & VECTOR) || (scalar && (flags & SCALAR));
+}
+
+Typecheck TypecheckProgram::satisfies_(SEXP value,
+                                       int index,
+                                       int depth) const {
+    const compiled_type_t& type = types_[index];
+    SEXPTYPE sexptype = TYPEOF(value);
+
+    if (type.match_mask & sexptype_bit(sexptype)) {
+        return Typecheck::Match;
+    }
+
+    std::uint8_t flags = type.atomic_flags[sexptype];
+
+    if (flags != 0) {
+        bool scalar = LENGTH(value) <= 1;
+
+        if (allows_na_(flags, scalar)) {
+            return Typecheck::Match;
+        }
+
+        if (allows_no_na_(flags, scalar)) {
+            return has_na(value) ? Typecheck::Mismatch : Typecheck::Match;
+        }
+
+        return Typecheck::Mismatch;
+    }
+
+    Typecheck result = Typecheck::Mismatch;
+
+    if (sexptype == VECSXP) {
+        for (int aggregate: type.aggregates) {
+            result = combine_alternatives(
+                result,
+                satisfies_aggregate_(value, aggregates_[aggregate], depth));
+
+            if (result == Typecheck::Match) {
+                return result;
+            }
+        }
+    }
+
+    return result;
+}
+
+/* an exact shape carries everything satisfies_ reads from a value that is
+   not a list. */
+Typecheck TypecheckProgram::satisfies_shape_(value_shape_t shape,
+                                             int index) const {
+    const compiled_type_t& type = types_[index];
+    SEXPTYPE sexptype = get_value_shape_sexptype(shape);
+
+    if (type.match_mask & sexptype_bit(sexptype)) {
+        return Typecheck::Match;
+    }
+
+    std::uint8_t flags = type.atomic_flags[sexptype];
+    bool scalar = is_scalar_value_shape(shape);
+
+    if (allows_na_(flags, scalar)) {
+        return Typecheck::Match;
+    }
+
+    if (allows_no_na_(flags, scalar)) {
+        return has_na_value_shape(shape) ? Typecheck::Mismatch
+                                         : Typecheck::Match;
+    }
+
+    return Typecheck::Mismatch;
+}
+
+Typecheck TypecheckProgram::satisfies_aggregate_(
+    SEXP value,
+    const compiled_aggregate_t& aggregate,
+    int depth) const {
+    int element_count = LENGTH(value);
+
+    if (aggregate.element_types.size() !=
+        static_cast<std::size_t>(element_count)) {
+        return Typecheck::Mismatch;
+    }
+
+    if (aggregate.is_struct) {
+        SEXP names = getAttrib(value, R_NamesSymbol);
+
+        if (LENGTH(names) != element_count) {
+            return Typecheck::Mismatch;
+        }
+
+        if (aggregate.tag_chars.size() != aggregate.tags.size()) {
+            for (const std::string& tag: aggregate.tags) {
+                SEXP tag_char = mkChar(tag.c_str());
+                R_PreserveObject(tag_char);
+                aggregate.tag_chars.push_back(tag_char);
+            }
+        }
+
+        for (int i = 0; i < element_count; ++i) {
+            SEXP name = STRING_ELT(names, i);
+            SEXP tag = aggregate.tag_chars[i];
+            /* CHARSXPs are cached, so pointers differ only if the strings
+               differ or are stored in different encodings. */
+            if (name != tag && strcmp(CHAR(name), CHAR(tag)) != 0) {
+                return Typecheck::Mismatch;
+            }
+        }
+    }
+
+    if (!is_within_depth_budget(depth)) {
+        return element_count == 0 ? Typecheck::Match : Typecheck::Partial;
+    }
+
+    int checked_count = get_budgeted_element_count(element_count);
+    Typecheck outcome = checked_count == element_count ? Typecheck::Match
+                                                       : Typecheck::Partial;
+
+    for (int i = 0; i < checked_count; ++i) {
+        int index = get_budgeted_element_index(i, element_count);
+        Typecheck result = satisfies_(VECTOR_ELT(value, index),
+                                      aggregate.element_types[index],
+                                      depth + 1);
+
+        if (result == Typecheck::Partial) {
+            outcome = result;
+        } else if (result != Typecheck::Match) {
+            return result;
+        }
+    }
+
+    return outcome;
+}
+
+Typecheck TypecheckProgram::satisfies_(const ValueShape& shape,
+                                       int index) const {
+    const compiled_type_t& type = types_[index];
+    SEXPTYPE sexptype = shape.get_sexptype();
+
+    if (type.match_mask & sexptype_bit(sexptype)) {
+        return Typecheck::Match;
+    }
+
+    std::uint8_t flags = type.atomic_flags[sexptype];
+
+    if (flags != 0) {
+        if (allows_na_(flags, shape.is_scalar())) {
+            return Typecheck::Match;
+        }
+
+        if (allows_no_na_(flags, shape.is_scalar())) {
+            return shape.has_na() ? Typecheck::Mismatch : Typecheck::Match;
+        }
+
+        return Typecheck::Mismatch;
+    }
+
+    Typecheck result = Typecheck::Mismatch;
+
+    if (sexptype == VECSXP) {
+        for (int aggregate: type.aggregates) {
+            result = combine_alternatives(
+                result, satisfies_aggregate_(shape, aggregates_[aggregate]));
+
+            if (result == Typecheck::Match) {
+                return result;
+            }
+        }
+    }
+
+    return result;
+}
+
+/* names and elements which were not captured can only make the outcome
+   Partial */
+Typecheck TypecheckProgram::satisfies_aggregate_(
+    const ValueShape& shape,
+    const compiled_aggregate_t& aggregate) const {
+    std::size_t element_count = shape.get_length();
+
+    if (aggregate.element_types.size() != element_count) {
+        return Typecheck::Mismatch;
+    }
+
+    Typecheck outcome = Typecheck::Match;
+
+    if (aggregate.is_struct) {
+        const std::vector<std::string>& names = shape.get_names();
+
+        if (!shape.has_names() && element_count != 0) {
+            return Typecheck::Mismatch;
+        }
+
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            if (names[i] != aggregate.tags[i]) {
+                return Typecheck::Mismatch;
+            }
+        }
+
+        if (names.size() != element_count) {
+            outcome = Typecheck::Partial;
+        }
+    }
+
+    const std::vector<ValueShape>& elements = shape.get_elements();
+
+    if (elements.size() != element_count) {
+        outcome = Typecheck::Partial;
+    }
+
+    for (std::size_t i = 0; i < elements.size(); ++i) {
+        Typecheck result =
+            satisfies_(elements[i], aggregate.element_types[i]);
+
+        if (result == Typecheck::Partial) {
+            outcome = result;
+        } else if (result != Typecheck::Match) {
+            return result;
+        }
+    }
+
+    return outcome;
+}
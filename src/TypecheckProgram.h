@@ -0,0 +1,193 @@
+#ifndef TYPETESTERDYNTRACER_TYPECHECK_PROGRAM_H
+#define TYPETESTERDYNTRACER_TYPECHECK_PROGRAM_H
+
+#include "ValueShape.h"
+#include "typechecker.h"
+
+#include <cstdint>
+#include <tastr/ast/ast.hpp>
+#include <vector>
+
+/* A FunctionTypeNode compiled into flat tables. Every type is flattened
+   into the union of its alternatives: unions, groups and nullables
+   disappear, alternatives that only depend on the sexptype of the value
+   become a bitmask, scalar and vector alternatives become per-sexptype
+   length and NA flags and only list and struct alternatives remain as
+   fallbacks that inspect the elements. The result of checking a value is
+   identical to satisfies on the original type. Programs can be serialized
+   and are built without calling into R, so that they can be compiled or
+   deserialized off the R thread.
+
+   Building with TYPECHECK_PROGRAM_CROSSCHECK defined keeps the type a
+   program is compiled from and checks every value against it with
+   satisfies as well, a differing outcome is an error. Type declarations
+   are then always parsed, since cached programs have no type to compare
+   with. make crosscheck installs this build and runs the corpus in
+   tests/crosscheck through it. */
+class TypecheckProgram {
+  public:
+    explicit TypecheckProgram(const tastr::ast::FunctionTypeNode& type);
+
+    /* deserializes a program written by serialize */
+    TypecheckProgram(const char* data, std::size_t size);
+
+    ~TypecheckProgram();
+
+    TypecheckProgram(const TypecheckProgram&) = delete;
+
+    TypecheckProgram& operator=(const TypecheckProgram&) = delete;
+
+    std::size_t get_parameter_count() const {
+        return parameter_types_.size();
+    }
+
+    bool is_vararg_parameter(int formal_parameter_position) const {
+        return parameter_varargs_.at(formal_parameter_position);
+    }
+
+    Typecheck satisfies_parameter(SEXP value,
+                                  int formal_parameter_position) const {
+        return crosscheck_(
+            value,
+            formal_parameter_position,
+            satisfies_(
+                value, parameter_types_.at(formal_parameter_position), 0));
+    }
+
+    /* true if checking value only depends on its sexptype, in which case
+       computing its shape is not worth it. */
+    bool is_shape_independent(SEXP value, int formal_parameter_position) const {
+        return is_shape_independent_(
+            value, parameter_types_.at(formal_parameter_position));
+    }
+
+    bool is_return_shape_independent(SEXP value) const {
+        return is_shape_independent_(value, return_type_);
+    }
+
+    /* sexptypes whose values the type of the parameter matches or not
+       depending on whether they have an NA, shapes of values checked
+       against the parameter are computed with this mask */
+    std::uint32_t
+    get_parameter_na_sexptype_mask(int formal_parameter_position) const {
+        return na_sexptype_masks_[parameter_types_.at(
+            formal_parameter_position)];
+    }
+
+    std::uint32_t get_return_na_sexptype_mask() const {
+        return na_sexptype_masks_[return_type_];
+    }
+
+    /* shape and shape_key are the shape of value, results are cached per
+       shape and cached results of lists are only used for the same key */
+    Typecheck satisfies_parameter(SEXP value,
+                                  int formal_parameter_position,
+                                  value_shape_t shape,
+                                  const std::string& shape_key) const;
+
+    Typecheck satisfies_return(SEXP value) const {
+        return crosscheck_(value, -1, satisfies_(value, return_type_, 0));
+    }
+
+    /* checks of captured shapes do not call into R and are not limited by
+       the typecheck budget */
+    Typecheck satisfies_parameter(const ValueShape& shape,
+                                  int formal_parameter_position) const {
+        return satisfies_(shape,
+                          parameter_types_.at(formal_parameter_position));
+    }
+
+    Typecheck satisfies_return(const ValueShape& shape) const {
+        return satisfies_(shape, return_type_);
+    }
+
+    /* appends the program to buffer */
+    void serialize(std::string& buffer) const;
+
+  private:
+    /* flags of a scalar or vector alternative for one sexptype */
+    static const std::uint8_t SCALAR_NA_ALLOWED = 1;
+    static const std::uint8_t SCALAR = 2;
+    static const std::uint8_t VECTOR_NA_ALLOWED = 4;
+    static const std::uint8_t VECTOR = 8;
+
+    static const int SEXPTYPE_COUNT = 32;
+
+    /* entries of the direct mapped shape cache of each parameter */
+    static const int SHAPE_CACHE_SIZE = 16;
+
+    struct compiled_type_t {
+        std::uint32_t match_mask;
+        std::uint8_t atomic_flags[SEXPTYPE_COUNT];
+        std::vector<int> aggregates;
+    };
+
+    /* list and struct alternatives, tags are only set for structs. The
+       tags are interned as CHARSXPs the first time they are compared. */
+    struct compiled_aggregate_t {
+        bool is_struct;
+        std::vector<std::string> tags;
+        std::vector<int> element_types;
+        mutable std::vector<SEXP> tag_chars;
+    };
+
+    struct shape_cache_entry_t {
+        value_shape_t shape;
+        Typecheck result;
+        std::string key;
+    };
+
+    static bool allows_na_(std::uint8_t flags, bool scalar);
+
+    static bool allows_no_na_(std::uint8_t flags, bool scalar);
+
+    int compile_(const tastr::ast::TypeNode& type);
+
+    /* sets up the tables derived from the compiled types */
+    void initialize_();
+
+    bool is_shape_independent_(SEXP value, int index) const;
+
+    /* returns result, the return value has position -1 */
+#ifdef TYPECHECK_PROGRAM_CROSSCHECK
+    Typecheck crosscheck_(SEXP value,
+                          int formal_parameter_position,
+                          Typecheck result) const;
+#else
+    Typecheck crosscheck_(SEXP /* value */,
+                          int /* formal_parameter_position */,
+                          Typecheck result) const {
+        return result;
+    }
+#endif
+
+    void add_alternative_(int index, const tastr::ast::TypeNode& type);
+
+    Typecheck satisfies_(SEXP value, int index, int depth) const;
+
+    Typecheck satisfies_shape_(value_shape_t shape, int index) const;
+
+    Typecheck satisfies_aggregate_(SEXP value,
+                                   const compiled_aggregate_t& aggregate,
+                                   int depth) const;
+
+    Typecheck satisfies_(const ValueShape& shape, int index) const;
+
+    Typecheck
+    satisfies_aggregate_(const ValueShape& shape,
+                         const compiled_aggregate_t& aggregate) const;
+
+    std::vector<compiled_type_t> types_;
+    std::vector<compiled_aggregate_t> aggregates_;
+    std::vector<int> parameter_types_;
+    std::vector<bool> parameter_varargs_;
+    int return_type_;
+    std::vector<std::uint32_t> na_sexptype_masks_;
+    mutable std::vector<shape_cache_entry_t> shape_cache_;
+#ifdef TYPECHECK_PROGRAM_CROSSCHECK
+    /* nullptr for deserialized programs */
+    std::unique_ptr<tastr::ast::TypeNode> type_;
+#endif
+};
+
+#endif /* TYPETESTERDYNTRACER_TYPECHECK_PROGRAM_H */
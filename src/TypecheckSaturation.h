@@ -0,0 +1,72 @@
+#ifndef TYPETESTERDYNTRACER_TYPECHECK_SATURATION_H
+#define TYPETESTERDYNTRACER_TYPECHECK_SATURATION_H
+
+#include "typechecker.h"
+
+#include <algorithm>
+#include <tuple>
+
+/* declaration set, formal parameter position and the shape of the values
+   whose checks were skipped */
+using skipped_typecheck_t = std::tuple<int, int, value_shape_t>;
+
+/* Saturation of the typechecks of one parameter, or of the return value,
+   of a function. Once threshold consecutive checks of values with the same
+   exact shape had the same outcome, values of that shape are only checked
+   after 1, 2, 4, ... skipped ones, up to TYPECHECK_SATURATION_MAX_INTERVAL.
+   Values of any other shape are checked and a differing shape or outcome
+   ends the saturation. Lists, whose shapes are hashes, and values without
+   a shape are always checked. */
+class TypecheckSaturation {
+  public:
+    TypecheckSaturation()
+        : shape_(UNDEFINED_VALUE_SHAPE)
+        , result_(Typecheck::Undefined)
+        , streak_(0)
+        , interval_(0)
+        , countdown_(0) {
+    }
+
+    bool should_check(value_shape_t shape, int threshold) const {
+        return threshold <= 0 || !is_saturable_(shape) || shape != shape_ ||
+               streak_ < threshold || countdown_ == 0;
+    }
+
+    void skip() {
+        if (countdown_ > 0) {
+            --countdown_;
+        }
+    }
+
+    void record(value_shape_t shape, Typecheck result, int threshold) {
+        if (!is_saturable_(shape) || shape != shape_ || result != result_) {
+            shape_ = shape;
+            result_ = result;
+            streak_ = 1;
+            interval_ = 0;
+            countdown_ = 0;
+            return;
+        }
+
+        ++streak_;
+
+        if (threshold > 0 && streak_ >= threshold) {
+            interval_ = std::min(std::max(2 * interval_, 1),
+                                 TYPECHECK_SATURATION_MAX_INTERVAL);
+            countdown_ = interval_;
+        }
+    }
+
+  private:
+    static bool is_saturable_(value_shape_t shape) {
+        return shape != UNDEFINED_VALUE_SHAPE && is_exact_value_shape(shape);
+    }
+
+    value_shape_t shape_;
+    Typecheck result_;
+    int streak_;
+    int interval_;
+    int countdown_;
+};
+
+#endif /* TYPETESTERDYNTRACER_TYPECHECK_SATURATION_H */
@@ -0,0 +1,220 @@
+#include "ValueShape.h"
+
+#include "base64.h"
+#include "constants.h"
+#include "typechecker.h"
+
+#include <algorithm>
+
+static bool is_atomic_sexptype(SEXPTYPE sexptype) {
+    switch (sexptype) {
+    case LGLSXP:
+    case INTSXP:
+    case REALSXP:
+    case CPLXSXP:
+    case STRSXP:
+    case RAWSXP:
+        return true;
+    default:
+        return false;
+    }
+}
+
+ValueShape ValueShape::capture(SEXP value) {
+    return capture_(value, 0);
+}
+
+ValueShape ValueShape::capture(SEXP value, bool na) {
+    if (!is_atomic_sexptype(TYPEOF(value))) {
+        return capture_(value, 0);
+    }
+
+    ValueShape shape;
+    shape.sexptype_ = TYPEOF(value);
+    shape.scalar_ = XLENGTH(value) <= 1;
+    shape.na_ = na;
+    return shape;
+}
+
+ValueShape ValueShape::capture_(SEXP value, int depth) {
+    ValueShape shape;
+
+    shape.sexptype_ = TYPEOF(value);
+
+    if (is_atomic_sexptype(shape.sexptype_)) {
+        shape.scalar_ = XLENGTH(value) <= 1;
+        shape.na_ = has_budgeted_na(value);
+        return shape;
+    }
+
+    if (shape.sexptype_ != VECSXP) {
+        return shape;
+    }
+
+    shape.length_ = LENGTH(value);
+
+    /* names are compared before elements, so they are kept even for lists
+       whose elements are too deep to be captured */
+    int captured_count =
+        std::min(shape.length_, VALUE_SHAPE_DESCRIPTOR_ELEMENT_LIMIT);
+    SEXP names = getAttrib(value, R_NamesSymbol);
+
+    shape.has_names_ = names != R_NilValue;
+
+    if (shape.has_names_) {
+        for (int i = 0; i < captured_count; ++i) {
+            shape.names_.push_back(CHAR(STRING_ELT(names, i)));
+        }
+    }
+
+    if (depth < VALUE_SHAPE_DESCRIPTOR_DEPTH) {
+        for (int i = 0; i < captured_count; ++i) {
+            shape.elements_.push_back(
+                capture_(VECTOR_ELT(value, i), depth + 1));
+        }
+    }
+
+    return shape;
+}
+
+std::string ValueShape::to_descriptor() const {
+    std::string descriptor;
+    write_(descriptor);
+    return descriptor;
+}
+
+void ValueShape::write_(std::string& descriptor) const {
+    descriptor.append(std::to_string(sexptype_));
+
+    if (is_atomic_sexptype(sexptype_)) {
+        descriptor.push_back(scalar_ ? 's' : 'v');
+        if (na_) {
+            descriptor.push_back('N');
+        }
+        return;
+    }
+
+    if (sexptype_ != VECSXP) {
+        return;
+    }
+
+    descriptor.push_back('[');
+    descriptor.append(std::to_string(length_));
+
+    if (has_names_) {
+        descriptor.push_back('#');
+        for (const std::string& name: names_) {
+            descriptor.push_back(';');
+            descriptor.append(base64_encode(
+                reinterpret_cast<const unsigned char*>(name.c_str()),
+                name.size()));
+        }
+    }
+
+    descriptor.push_back('|');
+
+    for (std::size_t i = 0; i < elements_.size(); ++i) {
+        if (i != 0) {
+            descriptor.push_back(',');
+        }
+        elements_[i].write_(descriptor);
+    }
+
+    descriptor.push_back(']');
+}
+
+bool ValueShape::parse(const std::string& descriptor, ValueShape& shape) {
+    std::size_t offset = 0;
+    shape = ValueShape();
+    return shape.read_(descriptor, offset) && offset == descriptor.size();
+}
+
+static bool read_number(const std::string& descriptor,
+                        std::size_t& offset,
+                        int& number) {
+    std::size_t start = offset;
+    number = 0;
+
+    while (offset < descriptor.size() && descriptor[offset] >= '0' &&
+           descriptor[offset] <= '9') {
+        number = 10 * number + (descriptor[offset] - '0');
+        ++offset;
+    }
+
+    return offset != start;
+}
+
+static bool read_char(const std::string& descriptor,
+                      std::size_t& offset,
+                      char expected) {
+    if (offset < descriptor.size() && descriptor[offset] == expected) {
+        ++offset;
+        return true;
+    }
+    return false;
+}
+
+bool ValueShape::read_(const std::string& descriptor, std::size_t& offset) {
+    int sexptype = 0;
+
+    if (!read_number(descriptor, offset, sexptype) || sexptype >= 32) {
+        return false;
+    }
+
+    sexptype_ = sexptype;
+
+    if (is_atomic_sexptype(sexptype_)) {
+        if (read_char(descriptor, offset, 's')) {
+            scalar_ = true;
+        } else if (read_char(descriptor, offset, 'v')) {
+            scalar_ = false;
+        } else {
+            return false;
+        }
+        na_ = read_char(descriptor, offset, 'N');
+        return true;
+    }
+
+    if (sexptype_ != VECSXP) {
+        return true;
+    }
+
+    if (!read_char(descriptor, offset, '[') ||
+        !read_number(descriptor, offset, length_)) {
+        return false;
+    }
+
+    has_names_ = read_char(descriptor, offset, '#');
+
+    while (has_names_ && read_char(descriptor, offset, ';')) {
+        std::size_t end = descriptor.find_first_of(";|", offset);
+        if (end == std::string::npos) {
+            return false;
+        }
+        names_.push_back(
+            base64_decode(descriptor.substr(offset, end - offset)));
+        offset = end;
+    }
+
+    if (!read_char(descriptor, offset, '|')) {
+        return false;
+    }
+
+    if (static_cast<int>(names_.size()) > length_) {
+        return false;
+    }
+
+    if (read_char(descriptor, offset, ']')) {
+        return true;
+    }
+
+    do {
+        elements_.emplace_back();
+        if (!elements_.back().read_(descriptor, offset)) {
+            return false;
+        }
+    } while (read_char(descriptor, offset, ','));
+
+    return read_char(descriptor, offset, ']') &&
+           static_cast<int>(elements_.size()) <= length_;
+}
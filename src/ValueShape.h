@@ -0,0 +1,91 @@
+#ifndef TYPETESTERDYNTRACER_VALUE_SHAPE_H
+#define TYPETESTERDYNTRACER_VALUE_SHAPE_H
+
+#include "stdlibs.h"
+
+#include <string>
+#include <vector>
+
+/* Everything TypecheckProgram reads from a value: its sexptype, whether its
+   length is at most one and whether it has an NA, and for lists their
+   length, names and the shapes of their elements. Elements are only
+   captured for the first VALUE_SHAPE_DESCRIPTOR_ELEMENT_LIMIT elements of
+   lists nested in fewer than VALUE_SHAPE_DESCRIPTOR_DEPTH lists, checks
+   that depend on the other elements are Partial. NAs are only looked for
+   in the elements the typecheck budget checks.
+
+   Shapes are written as descriptors, which are parsed and checked without
+   calling into R:
+
+     shape := sexptype [('s' | 'v') ['N']]
+            | sexptype '[' length ['#' (';' name)*] '|'
+              [shape (',' shape)*] ']'
+
+   where sexptype and length are decimal, flags are only written for
+   atomic vectors and names are base64 encoded. */
+class ValueShape {
+  public:
+    ValueShape()
+        : sexptype_(NILSXP)
+        , scalar_(true)
+        , na_(false)
+        , length_(0)
+        , has_names_(false) {
+    }
+
+    static ValueShape capture(SEXP value);
+
+    /* na is whether value has an NA if it is an atomic vector, it is known
+       when value was typechecked against a type sensitive to NAs */
+    static ValueShape capture(SEXP value, bool na);
+
+    /* returns false if descriptor is malformed */
+    static bool parse(const std::string& descriptor, ValueShape& shape);
+
+    std::string to_descriptor() const;
+
+    SEXPTYPE get_sexptype() const {
+        return sexptype_;
+    }
+
+    bool is_scalar() const {
+        return scalar_;
+    }
+
+    bool has_na() const {
+        return na_;
+    }
+
+    int get_length() const {
+        return length_;
+    }
+
+    bool has_names() const {
+        return has_names_;
+    }
+
+    const std::vector<std::string>& get_names() const {
+        return names_;
+    }
+
+    const std::vector<ValueShape>& get_elements() const {
+        return elements_;
+    }
+
+  private:
+    static ValueShape capture_(SEXP value, int depth);
+
+    void write_(std::string& descriptor) const;
+
+    bool read_(const std::string& descriptor, std::size_t& offset);
+
+    SEXPTYPE sexptype_;
+    bool scalar_;
+    bool na_;
+    int length_;
+    bool has_names_;
+    std::vector<std::string> names_;
+    std::vector<ValueShape> elements_;
+};
+
+#endif /* TYPETESTERDYNTRACER_VALUE_SHAPE_H */
@@ -0,0 +1,96 @@
+#include "benchmark.h"
+
+#include "nascan.h"
+#include "typechecker.h"
+#include "utilities.h"
+
+#include <chrono>
+
+/* the check typechecking did before the kernels */
+static bool has_na_element(SEXP value) {
+    R_xlen_t length = XLENGTH(value);
+
+    switch (TYPEOF(value)) {
+    case LGLSXP:
+        for (R_xlen_t i = 0; i < length; ++i) {
+            if (LOGICAL_ELT(value, i) == NA_LOGICAL) {
+                return true;
+            }
+        }
+        return false;
+
+    case INTSXP:
+        for (R_xlen_t i = 0; i < length; ++i) {
+            if (INTEGER_ELT(value, i) == NA_INTEGER) {
+                return true;
+            }
+        }
+        return false;
+
+    case REALSXP:
+        for (R_xlen_t i = 0; i < length; ++i) {
+            if (ISNAN(REAL_ELT(value, i))) {
+                return true;
+            }
+        }
+        return false;
+
+    case CPLXSXP:
+        for (R_xlen_t i = 0; i < length; ++i) {
+            Rcomplex element = COMPLEX_ELT(value, i);
+            if (ISNAN(element.r) || ISNAN(element.i)) {
+                return true;
+            }
+        }
+        return false;
+
+    case STRSXP:
+        for (R_xlen_t i = 0; i < length; ++i) {
+            if (STRING_ELT(value, i) == NA_STRING) {
+                return true;
+            }
+        }
+        return false;
+
+    default:
+        return false;
+    }
+}
+
+SEXP benchmark_na_scan(SEXP value, SEXP variant, SEXP iteration_count) {
+    const std::string variant_name = sexp_to_string(variant);
+    const std::string selected_variant = get_na_scan_variant();
+    const int count = sexp_to_int(iteration_count);
+    const bool element = variant_name == "element";
+
+    if (!element && !set_na_scan_variant(variant_name)) {
+        return ScalarReal(NA_REAL);
+    }
+
+    /* every scan is compared to the per element loop, which also keeps
+       them from being optimized out */
+    const bool expected = has_na_element(value);
+    bool mismatch = false;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < count; ++i) {
+        bool result = element ? has_na_element(value) : has_na(value);
+        mismatch = mismatch || result != expected;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    set_na_scan_variant(selected_variant);
+
+    if (mismatch) {
+        Rf_error("%s NA scan disagrees with the per element loop",
+                 variant_name.c_str());
+    }
+
+    double nanoseconds =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+            .count();
+
+    return ScalarReal(count <= 0 ? 0 : nanoseconds / count);
+}
@@ -0,0 +1,27 @@
+#ifndef TYPETESTERDYNTRACER_BENCHMARK_H
+#define TYPETESTERDYNTRACER_BENCHMARK_H
+
+#include <Rinternals.h>
+#undef TRUE
+#undef FALSE
+#undef length
+#undef eval
+#undef error
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Scans the atomic vector value for NAs iteration_count times with the
+   named NA scan kernel variant, "avx2", "sse2" or "scalar", or with the
+   per element loop over LOGICAL_ELT and friends for "element". Returns the
+   mean nanoseconds per scan, NA if the processor does not support the
+   variant, and signals an error if a scan disagrees with the per element
+   loop. The selected variant is restored afterwards. */
+SEXP benchmark_na_scan(SEXP value, SEXP variant, SEXP iteration_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TYPETESTERDYNTRACER_BENCHMARK_H */
@@ -38,3 +38,23 @@ const scope_t UNASSIGNED_SCOPE = "Unassigned";
 const scope_t TOP_LEVEL_SCOPE = "Top Level";
 
 extern const gc_cycle_t UNDEFINED_GC_CYCLE = -1;
+
+const int ENVIRONMENT_SKIP_DISTANCE = 16;
+
+const value_shape_t UNDEFINED_VALUE_SHAPE = 0;
+const int VALUE_SHAPE_DEPTH = 2;
+const int VALUE_SHAPE_ELEMENT_LIMIT = 16;
+
+/* bump whenever the serialized format of typecheck programs changes */
+const std::uint32_t TYPE_DECLARATION_CACHE_VERSION = 1;
+
+const int TYPECHECK_SATURATION_MAX_INTERVAL = 1024;
+
+const int VALUE_SHAPE_DESCRIPTOR_DEPTH = 4;
+const int VALUE_SHAPE_DESCRIPTOR_ELEMENT_LIMIT = 64;
+
+const int INFERRED_TYPE_DEPTH = 2;
+const std::size_t INFERRED_TYPE_AGGREGATE_LIMIT = 4;
+const std::size_t INFERRED_TYPE_ELEMENT_LIMIT = 8;
+
+const int PROBE_OVERHEAD_CALIBRATION_COUNT = 10001;
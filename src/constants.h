@@ -3,6 +3,7 @@
 
 #include "definitions.h"
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -39,4 +40,23 @@ extern const scope_t UNASSIGNED_SCOPE;
 extern const scope_t TOP_LEVEL_SCOPE;
 
 extern const gc_cycle_t UNDEFINED_GC_CYCLE;
+
+extern const int ENVIRONMENT_SKIP_DISTANCE;
+
+extern const value_shape_t UNDEFINED_VALUE_SHAPE;
+extern const int VALUE_SHAPE_DEPTH;
+extern const int VALUE_SHAPE_ELEMENT_LIMIT;
+
+extern const std::uint32_t TYPE_DECLARATION_CACHE_VERSION;
+
+extern const int TYPECHECK_SATURATION_MAX_INTERVAL;
+
+extern const int VALUE_SHAPE_DESCRIPTOR_DEPTH;
+extern const int VALUE_SHAPE_DESCRIPTOR_ELEMENT_LIMIT;
+
+extern const int INFERRED_TYPE_DEPTH;
+extern const std::size_t INFERRED_TYPE_AGGREGATE_LIMIT;
+extern const std::size_t INFERRED_TYPE_ELEMENT_LIMIT;
+
+extern const int PROBE_OVERHEAD_CALIBRATION_COUNT;
 #endif /* TYPETESTERDYNTRACER_CONSTANTS_H */
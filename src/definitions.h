@@ -31,4 +31,6 @@ typedef std::string scope_t;
 
 typedef int gc_cycle_t;
 
+typedef unsigned long long int value_shape_t;
+
 #endif /* TYPETESTERDYNTRACER_DEFINITIONS_H */
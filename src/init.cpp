@@ -1,3 +1,5 @@
+#include "benchmark.h"
+#include "retypecheck.h"
 #include "table.h"
 #include "tracer.h"
 
@@ -9,10 +11,13 @@ extern "C" {
 #endif
 
 static const R_CallMethodDef CallEntries[] = {
-    {"create_dyntracer", (DL_FUNC) &create_dyntracer, 6},
+    {"create_dyntracer", (DL_FUNC) &create_dyntracer, 22},
     {"destroy_dyntracer", (DL_FUNC) &destroy_dyntracer, 1},
+    {"reload_type_declarations", (DL_FUNC) &reload_type_declarations, 1},
     {"write_data_table", (DL_FUNC) &write_data_table, 5},
     {"read_data_table", (DL_FUNC) &read_data_table, 3},
+    {"retypecheck_value_shapes", (DL_FUNC) &retypecheck_value_shapes, 9},
+    {"benchmark_na_scan", (DL_FUNC) &benchmark_na_scan, 3},
     {NULL, NULL, 0}};
 
 void attribute_visible R_init_typetesterdyntracer(DllInfo* dll) {
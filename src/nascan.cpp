@@ -0,0 +1,316 @@
+#include "nascan.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    define NASCAN_X86 1
+#    include <immintrin.h>
+#endif
+
+/* scalar variants, also used for the tails of the vectorized variants */
+
+static bool has_na_integer_scalar(const int* data, R_xlen_t length) {
+    for (R_xlen_t i = 0; i < length; ++i) {
+        if (data[i] == NA_INTEGER) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* NA_REAL is a NaN, a double is NaN iff it is unordered with itself */
+static bool has_na_real_scalar(const double* data, R_xlen_t length) {
+    for (R_xlen_t i = 0; i < length; ++i) {
+        if (ISNAN(data[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool has_na_string_scalar(const SEXP* data, R_xlen_t length) {
+    for (R_xlen_t i = 0; i < length; ++i) {
+        if (data[i] == NA_STRING) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifdef NASCAN_X86
+
+/* SSE2 variants */
+
+__attribute__((target("sse2"))) static bool
+has_na_integer_sse2(const int* data, R_xlen_t length) {
+    const __m128i na = _mm_set1_epi32(NA_INTEGER);
+    R_xlen_t i = 0;
+
+    for (; i + 8 <= length; i += 8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i b =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 4));
+        __m128i eq = _mm_or_si128(_mm_cmpeq_epi32(a, na), _mm_cmpeq_epi32(b, na));
+        if (_mm_movemask_epi8(eq) != 0) {
+            return true;
+        }
+    }
+
+    return has_na_integer_scalar(data + i, length - i);
+}
+
+__attribute__((target("sse2"))) static bool
+has_na_real_sse2(const double* data, R_xlen_t length) {
+    R_xlen_t i = 0;
+
+    for (; i + 4 <= length; i += 4) {
+        __m128d a = _mm_loadu_pd(data + i);
+        __m128d b = _mm_loadu_pd(data + i + 2);
+        __m128d unordered = _mm_or_pd(_mm_cmpunord_pd(a, a),
+                                      _mm_cmpunord_pd(b, b));
+        if (_mm_movemask_pd(unordered) != 0) {
+            return true;
+        }
+    }
+
+    return has_na_real_scalar(data + i, length - i);
+}
+
+/* SSE2 has no 64 bit compare, a pointer is equal iff both of its 32 bit
+   halves are. */
+__attribute__((target("sse2"))) static bool
+has_na_string_sse2(const SEXP* data, R_xlen_t length) {
+    if (sizeof(SEXP) != 8) {
+        return has_na_string_scalar(data, length);
+    }
+
+    const __m128i na =
+        _mm_set1_epi64x(reinterpret_cast<long long>(NA_STRING));
+    R_xlen_t i = 0;
+
+    for (; i + 2 <= length; i += 2) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi32(a, na));
+        if ((mask & 0x00FF) == 0x00FF || (mask & 0xFF00) == 0xFF00) {
+            return true;
+        }
+    }
+
+    return has_na_string_scalar(data + i, length - i);
+}
+
+/* AVX2 variants */
+
+__attribute__((target("avx2"))) static bool
+has_na_integer_avx2(const int* data, R_xlen_t length) {
+    const __m256i na = _mm256_set1_epi32(NA_INTEGER);
+    R_xlen_t i = 0;
+
+    for (; i + 16 <= length; i += 16) {
+        __m256i a =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i b =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 8));
+        __m256i eq = _mm256_or_si256(_mm256_cmpeq_epi32(a, na),
+                                     _mm256_cmpeq_epi32(b, na));
+        if (!_mm256_testz_si256(eq, eq)) {
+            return true;
+        }
+    }
+
+    return has_na_integer_scalar(data + i, length - i);
+}
+
+__attribute__((target("avx2"))) static bool
+has_na_real_avx2(const double* data, R_xlen_t length) {
+    R_xlen_t i = 0;
+
+    for (; i + 8 <= length; i += 8) {
+        __m256d a = _mm256_loadu_pd(data + i);
+        __m256d b = _mm256_loadu_pd(data + i + 4);
+        __m256d unordered = _mm256_or_pd(_mm256_cmp_pd(a, a, _CMP_UNORD_Q),
+                                         _mm256_cmp_pd(b, b, _CMP_UNORD_Q));
+        if (_mm256_movemask_pd(unordered) != 0) {
+            return true;
+        }
+    }
+
+    return has_na_real_scalar(data + i, length - i);
+}
+
+__attribute__((target("avx2"))) static bool
+has_na_string_avx2(const SEXP* data, R_xlen_t length) {
+    if (sizeof(SEXP) != 8) {
+        return has_na_string_scalar(data, length);
+    }
+
+    const __m256i na =
+        _mm256_set1_epi64x(reinterpret_cast<long long>(NA_STRING));
+    R_xlen_t i = 0;
+
+    for (; i + 4 <= length; i += 4) {
+        __m256i a =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i eq = _mm256_cmpeq_epi64(a, na);
+        if (!_mm256_testz_si256(eq, eq)) {
+            return true;
+        }
+    }
+
+    return has_na_string_scalar(data + i, length - i);
+}
+
+#endif /* NASCAN_X86 */
+
+struct na_scan_kernels_t {
+    const char* variant;
+    bool (*integer)(const int*, R_xlen_t);
+    bool (*real)(const double*, R_xlen_t);
+    bool (*string)(const SEXP*, R_xlen_t);
+};
+
+/* returns false if the processor does not support the variant */
+static bool find_na_scan_kernels(const std::string& variant,
+                                 na_scan_kernels_t& kernels) {
+#ifdef NASCAN_X86
+    __builtin_cpu_init();
+
+    if (variant == "avx2" && __builtin_cpu_supports("avx2")) {
+        kernels = {"avx2",
+                   has_na_integer_avx2,
+                   has_na_real_avx2,
+                   has_na_string_avx2};
+        return true;
+    }
+
+    if (variant == "sse2" && __builtin_cpu_supports("sse2")) {
+        kernels = {"sse2",
+                   has_na_integer_sse2,
+                   has_na_real_sse2,
+                   has_na_string_sse2};
+        return true;
+    }
+#endif
+
+    if (variant == "scalar") {
+        kernels = {"scalar",
+                   has_na_integer_scalar,
+                   has_na_real_scalar,
+                   has_na_string_scalar};
+        return true;
+    }
+
+    return false;
+}
+
+static na_scan_kernels_t select_na_scan_kernels() {
+    na_scan_kernels_t kernels;
+
+    for (const char* variant: {"avx2", "sse2", "scalar"}) {
+        if (find_na_scan_kernels(variant, kernels)) {
+            break;
+        }
+    }
+
+    return kernels;
+}
+
+static na_scan_kernels_t& get_na_scan_kernels() {
+    static na_scan_kernels_t kernels = select_na_scan_kernels();
+    return kernels;
+}
+
+static ThreadPool* na_scan_pool = nullptr;
+static R_xlen_t na_scan_length_threshold = 0;
+
+/* elements scanned between checks for an NA found by another thread */
+static const R_xlen_t NA_SCAN_BLOCK_SIZE = 1 << 16;
+
+void configure_parallel_na_scan(int thread_count, R_xlen_t length_threshold) {
+    delete na_scan_pool;
+    na_scan_pool = nullptr;
+
+    if (thread_count > 0) {
+        na_scan_pool = new ThreadPool(thread_count);
+    }
+
+    na_scan_length_threshold = length_threshold;
+}
+
+/* The vector is split into one range per worker plus one for the calling
+   thread. Workers only read the data, NA_INTEGER and NA_STRING, they never
+   call into R. */
+template <typename T>
+static bool has_na_parallel(bool (*kernel)(const T*, R_xlen_t),
+                            const T* data,
+                            R_xlen_t length) {
+    if (na_scan_pool == nullptr || length < na_scan_length_threshold) {
+        return kernel(data, length);
+    }
+
+    std::atomic<bool> found(false);
+
+    auto scan_range = [&found, kernel, data](R_xlen_t begin, R_xlen_t end) {
+        for (R_xlen_t block = begin; block < end; block += NA_SCAN_BLOCK_SIZE) {
+            if (found.load(std::memory_order_relaxed)) {
+                return;
+            }
+
+            R_xlen_t count = std::min(NA_SCAN_BLOCK_SIZE, end - block);
+
+            if (kernel(data + block, count)) {
+                found.store(true, std::memory_order_relaxed);
+                return;
+            }
+        }
+    };
+
+    int range_count = na_scan_pool->get_thread_count() + 1;
+    R_xlen_t range_size = (length + range_count - 1) / range_count;
+    std::vector<std::future<void>> futures;
+
+    for (R_xlen_t begin = range_size; begin < length; begin += range_size) {
+        R_xlen_t end = std::min(begin + range_size, length);
+        futures.push_back(na_scan_pool->submit(
+            [&scan_range, begin, end] { scan_range(begin, end); }));
+    }
+
+    scan_range(0, std::min(range_size, length));
+
+    for (std::future<void>& future: futures) {
+        future.wait();
+    }
+
+    return found.load();
+}
+
+bool has_na_integer(const int* data, R_xlen_t length) {
+    return has_na_parallel(get_na_scan_kernels().integer, data, length);
+}
+
+bool has_na_real(const double* data, R_xlen_t length) {
+    return has_na_parallel(get_na_scan_kernels().real, data, length);
+}
+
+/* a complex is NA if either part is NaN, so the parts are scanned as one
+   double vector of twice the length. */
+bool has_na_complex(const Rcomplex* data, R_xlen_t length) {
+    return has_na_parallel(get_na_scan_kernels().real,
+                           reinterpret_cast<const double*>(data),
+                           2 * length);
+}
+
+bool has_na_string(const SEXP* data, R_xlen_t length) {
+    return has_na_parallel(get_na_scan_kernels().string, data, length);
+}
+
+const char* get_na_scan_variant() {
+    return get_na_scan_kernels().variant;
+}
+
+bool set_na_scan_variant(const std::string& variant) {
+    return find_na_scan_kernels(variant, get_na_scan_kernels());
+}
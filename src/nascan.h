@@ -0,0 +1,35 @@
+#ifndef TYPETESTERDYNTRACER_NASCAN_H
+#define TYPETESTERDYNTRACER_NASCAN_H
+
+#include "stdlibs.h"
+
+#include <string>
+
+/* NA detection over contiguous vector data. Each kernel has an AVX2, an
+   SSE2 and a scalar variant, the best one supported by the processor is
+   selected the first time a kernel is called. Logical vectors use the
+   integer kernel since NA_LOGICAL is NA_INTEGER. Vectors of at least
+   length_threshold elements are split across a pool of thread_count
+   workers once parallel scanning is configured. */
+
+bool has_na_integer(const int* data, R_xlen_t length);
+
+bool has_na_real(const double* data, R_xlen_t length);
+
+bool has_na_complex(const Rcomplex* data, R_xlen_t length);
+
+bool has_na_string(const SEXP* data, R_xlen_t length);
+
+/* a thread_count below one disables parallel scanning and stops the
+   workers */
+void configure_parallel_na_scan(int thread_count, R_xlen_t length_threshold);
+
+/* name of the selected kernel variant: "avx2", "sse2" or "scalar" */
+const char* get_na_scan_variant();
+
+/* selects the named kernel variant instead, returns false and keeps the
+   selected one if the processor does not support it. Only called while no
+   scan runs, by the NA scan microbenchmark. */
+bool set_na_scan_variant(const std::string& variant);
+
+#endif /* TYPETESTERDYNTRACER_NASCAN_H */
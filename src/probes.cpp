@@ -1,22 +1,42 @@
 #include "probes.h"
 
 #include "TracerState.h"
+#include "ValueShape.h"
 
 inline TracerState& tracer_state(dyntracer_t* dyntracer) {
     return *(static_cast<TracerState*>(dyntracer->state));
 }
 
-Typecheck typecheck_function_result(Call* call, SEXP return_value) {
+/* shape is set to the shape typecheck saturation of the return value is
+   keyed on, lists are checked without one. Saturated checks are skipped. */
+Typecheck typecheck_function_result(Call* call,
+                                    SEXP return_value,
+                                    int declaration_set,
+                                    int saturation_threshold,
+                                    value_shape_t& shape) {
     Function* function = call->get_function();
-    Typecheck match_result;
 
-    if (function->has_valid_type_declaration()) {
-        match_result = satisfies(return_value, function->get_return_type());
-    } else {
-        match_result = Typecheck::NotAvailable;
+    if (!function->has_valid_type_declaration(declaration_set)) {
+        return Typecheck::NotAvailable;
+    }
+
+    const TypecheckProgram& program =
+        function->get_typecheck_program(declaration_set);
+
+    if (program.is_return_shape_independent(return_value)) {
+        shape = get_sexptype_value_shape(TYPEOF(return_value));
+    } else if (TYPEOF(return_value) != VECSXP) {
+        std::string shape_key;
+        shape = compute_value_shape(
+            return_value, program.get_return_na_sexptype_mask(), shape_key);
     }
 
-    return match_result;
+    if (!function->get_typecheck_saturation(declaration_set, -1)
+             .should_check(shape, saturation_threshold)) {
+        return Typecheck::Saturated;
+    }
+
+    return program.satisfies_return(return_value);
 }
 
 static void search_promises_in_frame(dyntracer_t* dyntracer, SEXP frame) {
@@ -122,9 +142,7 @@ static inline void set_dispatch(Call* call,
 void eval_entry(dyntracer_t* dyntracer, const SEXP expr, const SEXP rho) {
     TracerState& state = tracer_state(dyntracer);
 
-    state.enter_probe(Event::EvalEntry);
-
-    state.exit_probe(Event::EvalEntry);
+    state.count_event(Event::EvalEntry);
 }
 
 void closure_argument_list_creation_entry(dyntracer_t* dyntracer,
@@ -133,22 +151,18 @@ void closure_argument_list_creation_entry(dyntracer_t* dyntracer,
                                           const SEXP parent_rho) {
     TracerState& state = tracer_state(dyntracer);
 
-    state.enter_probe(Event::ArgumentListCreationEntry);
+    state.count_event(Event::ArgumentListCreationEntry);
 
     state.enable_argument_list_creation_mode();
-
-    state.exit_probe(Event::ArgumentListCreationEntry);
 }
 
 void closure_argument_list_creation_exit(dyntracer_t* dyntracer,
                                          const SEXP rho) {
     TracerState& state = tracer_state(dyntracer);
 
-    state.enter_probe(Event::ArgumentListCreationExit);
+    state.count_event(Event::ArgumentListCreationExit);
 
     state.disable_argument_list_creation_mode();
-
-    state.exit_probe(Event::ArgumentListCreationExit);
 }
 
 void closure_entry(dyntracer_t* dyntracer,
@@ -193,32 +207,79 @@ void closure_exit(dyntracer_t* dyntracer,
 
     state.notify_caller(function_call);
 
+    Function* function = function_call->get_function();
+    int set_count = function->get_type_declaration_set_count();
+    sexptype_t return_type = type_of_sexp(return_value);
+
     for (const Argument* argument: function_call->get_arguments()) {
-        state.add_typechecking_result(
-            function_call->get_function()->get_id(),
-            function_call->get_id(),
-            argument->get_formal_parameter_position(),
-            argument->get_actual_argument_position(),
-            argument->is_default_argument(),
-            argument->is_dot_dot_dot(),
-            argument->get_denoted_value()->is_forced(),
-            argument->get_outer_type(),
-            argument->get_inner_type(),
-            argument->get_typechecking_result());
-    }
-
-    Typecheck result = typecheck_function_result(function_call, return_value);
-
-    state.add_typechecking_result(function_call->get_function()->get_id(),
-                                  function_call->get_id(),
-                                  -1,
-                                  -1,
-                                  false,
-                                  false,
-                                  false,
-                                  type_of_sexp(return_value),
-                                  type_of_sexp(return_value),
-                                  result);
+        const ValueShape* value_shape = argument->get_value_shape();
+        int value_shape_id = state.get_value_shape_id(value_shape);
+
+        if (state.is_inferring_signatures() && value_shape != nullptr) {
+            function->get_inferred_signature().add_parameter(
+                argument->get_formal_parameter_position(),
+                argument->is_dot_dot_dot(),
+                *value_shape);
+        }
+
+        for (int declaration_set = 0; declaration_set < set_count;
+             ++declaration_set) {
+            state.add_typechecking_result(
+                function,
+                declaration_set,
+                function_call->get_id(),
+                argument->get_formal_parameter_position(),
+                argument->get_actual_argument_position(),
+                argument->is_default_argument(),
+                argument->is_dot_dot_dot(),
+                argument->get_denoted_value()->is_forced(),
+                argument->get_outer_type(),
+                argument->get_inner_type(),
+                argument->get_typechecking_result(declaration_set),
+                argument->get_typechecking_shape(declaration_set),
+                value_shape_id);
+        }
+    }
+
+    if (is_parameter_profiling_enabled()) {
+        function->get_parameter_profile(-1).add(return_value);
+    }
+
+    int return_value_shape_id = -1;
+
+    if (is_value_shape_capture_enabled()) {
+        ValueShape return_value_shape = ValueShape::capture(return_value);
+        return_value_shape_id = state.get_value_shape_id(&return_value_shape);
+
+        if (state.is_inferring_signatures()) {
+            function->get_inferred_signature().add_return(return_value_shape);
+        }
+    }
+
+    for (int declaration_set = 0; declaration_set < set_count;
+         ++declaration_set) {
+        value_shape_t shape = UNDEFINED_VALUE_SHAPE;
+        Typecheck result = typecheck_function_result(
+            function_call,
+            return_value,
+            declaration_set,
+            state.get_typecheck_budget().saturation_threshold,
+            shape);
+
+        state.add_typechecking_result(function,
+                                      declaration_set,
+                                      function_call->get_id(),
+                                      -1,
+                                      -1,
+                                      false,
+                                      false,
+                                      false,
+                                      return_type,
+                                      return_type,
+                                      result,
+                                      shape,
+                                      return_value_shape_id);
+    }
 
     state.destroy_call(function_call);
 
@@ -379,7 +440,7 @@ void context_entry(dyntracer_t* dyntracer, const RCNTXT* cptr) {
 }
 
 void jump_single_context(TracerState& state,
-                         ExecutionContext& exec_ctxt,
+                         const ExecutionContext& exec_ctxt,
                          bool returned,
                          const sexptype_t return_value_type,
                          const SEXP rho) {
@@ -423,7 +484,7 @@ void context_jump(dyntracer_t* dyntracer,
    because only one promise can be held responsible for non local
    return, the one that invokes the return function. */
 
-    execution_contexts_t exec_ctxts(state.unwind_stack(context));
+    const execution_contexts_t& exec_ctxts(state.unwind_stack(context));
 
     const SEXP rho = context->cloenv;
 
@@ -542,6 +603,9 @@ void promise_force_exit(dyntracer_t* dyntracer, const SEXP promise) {
 
     promise_state->set_execution_time(exec_ctxt.get_execution_time());
 
+    promise_state->set_corrected_execution_time(
+        state.get_corrected_execution_time(exec_ctxt));
+
     if (promise_state->is_argument()) {
         for (Argument* argument: promise_state->get_arguments()) {
             argument->typecheck(promise);
@@ -744,16 +808,16 @@ void environment_variable_assign(dyntracer_t* dyntracer,
     state.exit_probe(Event::EnvironmentVariableAssign);
 }
 
+/* the removed binding is not looked up, so removing a variable that was
+   never seen no longer allocates an environment or variable id for it.
+   Ids of later variables are shifted down accordingly, a later lookup of
+   the symbol creates the same undefined binding. */
 void environment_variable_remove(dyntracer_t* dyntracer,
                                  const SEXP symbol,
                                  const SEXP rho) {
     TracerState& state = tracer_state(dyntracer);
 
-    state.enter_probe(Event::EnvironmentVariableRemove);
-
-    Variable var = state.lookup_variable(rho, symbol);
-
-    state.exit_probe(Event::EnvironmentVariableRemove);
+    state.count_event(Event::EnvironmentVariableRemove);
 }
 
 void environment_variable_lookup(dyntracer_t* dyntracer,
@@ -826,7 +890,7 @@ void substitute_call(dyntracer_t* dyntracer,
         affected_call = state.find_call(environment, CLOSXP);
         if (affected_call == nullptr) {
             subst_class = SubstituteClass::NewScope;
-        } else if (is_parent_environment(environment, rho)) {
+        } else if (state.is_parent_environment(environment, rho)) {
             subst_class = SubstituteClass::StaticScope;
         } else {
             subst_class = SubstituteClass::DynamicScope;
@@ -0,0 +1,210 @@
+#include "retypecheck.h"
+
+#include "ThreadPool.h"
+#include "TypeDeclarationCache.h"
+#include "ValueShape.h"
+#include "utilities.h"
+
+#include <algorithm>
+
+/* calls body on consecutive ranges of [0, count) on the threads of pool */
+static void
+parallel_for(ThreadPool& pool,
+             std::size_t count,
+             const std::function<void(std::size_t, std::size_t)>& body) {
+    std::size_t task_count = 4 * pool.get_thread_count();
+    std::size_t chunk_size = std::max<std::size_t>(
+        1, (count + task_count - 1) / task_count);
+    std::vector<std::future<void>> futures;
+
+    for (std::size_t begin = 0; begin < count; begin += chunk_size) {
+        std::size_t end = std::min(begin + chunk_size, count);
+        futures.push_back(pool.submit([&body, begin, end] {
+            body(begin, end);
+        }));
+    }
+
+    for (std::future<void>& future: futures) {
+        future.get();
+    }
+}
+
+/* splits the name string of function_definitions, "(pkg::a pkg::b)", into
+   the names the function was called by */
+static std::vector<std::string>
+split_function_names(const std::string& names, const std::string& package) {
+    std::vector<std::string> result;
+    const std::string prefix = package + "::";
+    std::size_t begin = names.empty() || names[0] != '(' ? 0 : 1;
+    std::size_t end = names.size();
+
+    if (end > begin && names[end - 1] == ')') {
+        --end;
+    }
+
+    while (begin < end) {
+        std::size_t separator = std::min(names.find(' ', begin), end);
+        std::string name = names.substr(begin, separator - begin);
+
+        if (name.compare(0, prefix.size(), prefix) == 0) {
+            name = name.substr(prefix.size());
+        }
+
+        if (!name.empty()) {
+            result.push_back(name);
+        }
+
+        begin = separator + 1;
+    }
+
+    return result;
+}
+
+/* like a traced function, the declaration of the first name that has one
+   is used */
+static const TypecheckProgram*
+resolve_type_declaration(TypeDeclarationCache& type_declaration_cache,
+                         const std::string& package,
+                         const std::string& names) {
+    if (package.empty()) {
+        return nullptr;
+    }
+
+    for (const std::string& name: split_function_names(names, package)) {
+        const TypecheckProgram* program =
+            type_declaration_cache.get_function_type(package, name);
+
+        if (program != nullptr) {
+            return program;
+        }
+    }
+
+    return nullptr;
+}
+
+static Typecheck retypecheck(const TypecheckProgram* program,
+                             int formal_parameter_position,
+                             bool dot_dot_dot,
+                             const ValueShape* shape) {
+    if (program == nullptr) {
+        return Typecheck::NotAvailable;
+    }
+
+    if (formal_parameter_position >= 0 &&
+        static_cast<std::size_t>(formal_parameter_position) >=
+            program->get_parameter_count()) {
+        return Typecheck::Mismatch;
+    }
+
+    if (dot_dot_dot && formal_parameter_position >= 0 &&
+        program->is_vararg_parameter(formal_parameter_position)) {
+        return Typecheck::Match;
+    }
+
+    if (shape == nullptr) {
+        return Typecheck::Undefined;
+    }
+
+    if (formal_parameter_position < 0) {
+        return program->satisfies_return(*shape);
+    }
+
+    return program->satisfies_parameter(*shape, formal_parameter_position);
+}
+
+SEXP retypecheck_value_shapes(SEXP type_declaration_dirpath,
+                              SEXP packages,
+                              SEXP function_names,
+                              SEXP formal_parameter_positions,
+                              SEXP dot_dot_dots,
+                              SEXP value_shape_ids,
+                              SEXP shape_ids,
+                              SEXP shape_descriptors,
+                              SEXP thread_count) {
+    const std::size_t check_count = LENGTH(packages);
+    const std::size_t shape_count = LENGTH(shape_ids);
+    ThreadPool pool(std::max(1, sexp_to_int(thread_count)));
+
+    std::vector<std::string> descriptors(shape_count);
+    std::unordered_map<int, std::size_t> shape_indices;
+
+    for (std::size_t i = 0; i < shape_count; ++i) {
+        descriptors[i] = CHAR(STRING_ELT(shape_descriptors, i));
+        shape_indices.insert({INTEGER(shape_ids)[i], i});
+    }
+
+    std::vector<ValueShape> shapes(shape_count);
+    std::vector<char> valid_shapes(shape_count, false);
+
+    parallel_for(pool, shape_count, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            valid_shapes[i] = ValueShape::parse(descriptors[i], shapes[i]);
+        }
+    });
+
+    /* declarations are resolved on the R thread, the cache is not thread
+       safe and deserializes programs lazily */
+    TypeDeclarationCache type_declaration_cache(
+        sexp_to_string(type_declaration_dirpath));
+    std::vector<std::string> package_names;
+    std::map<std::pair<std::string, std::string>, const TypecheckProgram*>
+        programs;
+    std::vector<const TypecheckProgram*> check_programs(check_count);
+    std::vector<const ValueShape*> check_shapes(check_count, nullptr);
+
+    for (std::size_t i = 0; i < check_count; ++i) {
+        package_names.push_back(CHAR(STRING_ELT(packages, i)));
+    }
+
+    std::sort(package_names.begin(), package_names.end());
+    package_names.erase(std::unique(package_names.begin(), package_names.end()),
+                        package_names.end());
+    type_declaration_cache.preload(package_names, pool.get_thread_count());
+
+    for (std::size_t i = 0; i < check_count; ++i) {
+        std::pair<std::string, std::string> key(
+            CHAR(STRING_ELT(packages, i)), CHAR(STRING_ELT(function_names, i)));
+        auto iter = programs.find(key);
+
+        if (iter == programs.end()) {
+            iter = programs
+                       .insert({key,
+                                resolve_type_declaration(type_declaration_cache,
+                                                         key.first,
+                                                         key.second)})
+                       .first;
+        }
+
+        check_programs[i] = iter->second;
+
+        auto shape_iter = shape_indices.find(INTEGER(value_shape_ids)[i]);
+
+        if (shape_iter != shape_indices.end() &&
+            valid_shapes[shape_iter->second]) {
+            check_shapes[i] = &shapes[shape_iter->second];
+        }
+    }
+
+    std::vector<Typecheck> results(check_count, Typecheck::Undefined);
+    const int* positions = INTEGER(formal_parameter_positions);
+    const int* dots = LOGICAL(dot_dot_dots);
+
+    parallel_for(pool, check_count, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            results[i] = retypecheck(check_programs[i],
+                                     positions[i],
+                                     dots[i] == 1,
+                                     check_shapes[i]);
+        }
+    });
+
+    SEXP r_results = PROTECT(allocVector(STRSXP, check_count));
+
+    for (std::size_t i = 0; i < check_count; ++i) {
+        SET_STRING_ELT(r_results, i, mkChar(to_string(results[i]).c_str()));
+    }
+
+    UNPROTECT(1);
+
+    return r_results;
+}
@@ -0,0 +1,36 @@
+#ifndef TYPETESTERDYNTRACER_RETYPECHECK_H
+#define TYPETESTERDYNTRACER_RETYPECHECK_H
+
+#include <Rinternals.h>
+#undef TRUE
+#undef FALSE
+#undef length
+#undef eval
+#undef error
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Typechecks values captured in the value_shapes table of a trace against
+   the declarations in type_declaration_dirpath, without tracing the
+   program again. Each check is described by the package and name string
+   of the function, the formal parameter position, -1 for return values,
+   whether the value was passed through dot dot dot and the id of the value
+   shape. Shapes are parsed and checked on thread_count threads. Returns
+   the outcome of each check. */
+SEXP retypecheck_value_shapes(SEXP type_declaration_dirpath,
+                              SEXP packages,
+                              SEXP function_names,
+                              SEXP formal_parameter_positions,
+                              SEXP dot_dot_dots,
+                              SEXP value_shape_ids,
+                              SEXP shape_ids,
+                              SEXP shape_descriptors,
+                              SEXP thread_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TYPETESTERDYNTRACER_RETYPECHECK_H */
@@ -2,6 +2,21 @@
 
 #include "probes.h"
 
+/* the key columns of each table, as a list of character vectors named by
+   table */
+static aggregate_keys_t sexp_to_aggregate_keys(SEXP value) {
+    aggregate_keys_t aggregate_keys;
+    SEXP names = getAttrib(value, R_NamesSymbol);
+
+    for (int i = 0; i < LENGTH(value) && names != R_NilValue; ++i) {
+        aggregate_keys.insert(
+            {CHAR(STRING_ELT(names, i)),
+             sexp_to_string_vector(VECTOR_ELT(value, i))});
+    }
+
+    return aggregate_keys;
+}
+
 extern "C" {
 
 SEXP create_dyntracer(SEXP type_declaration_dirpath,
@@ -9,13 +24,46 @@ SEXP create_dyntracer(SEXP type_declaration_dirpath,
                       SEXP verbose,
                       SEXP truncate,
                       SEXP binary,
-                      SEXP compression_level) {
-    void* state = new TracerState(sexp_to_string(type_declaration_dirpath),
-                                  sexp_to_string(output_dirpath),
-                                  sexp_to_bool(verbose),
-                                  sexp_to_bool(truncate),
-                                  sexp_to_bool(binary),
-                                  sexp_to_int(compression_level));
+                      SEXP compression_level,
+                      SEXP typecheck_element_limit,
+                      SEXP typecheck_depth_limit,
+                      SEXP typecheck_sampling,
+                      SEXP typecheck_saturation_threshold,
+                      SEXP na_scan_thread_count,
+                      SEXP na_scan_length_threshold,
+                      SEXP preload_type_declarations,
+                      SEXP preload_thread_count,
+                      SEXP capture_value_shapes,
+                      SEXP infer_signatures,
+                      SEXP profile_parameters,
+                      SEXP aggregate_tables,
+                      SEXP aggregate_keys,
+                      SEXP aggregate_checkpoint_interval,
+                      SEXP measure_probe_latency,
+                      SEXP execution_clock) {
+    void* state = new TracerState(
+        sexp_to_string_vector(type_declaration_dirpath),
+        sexp_to_string(output_dirpath),
+        sexp_to_bool(verbose),
+        sexp_to_bool(truncate),
+        sexp_to_bool(binary),
+        sexp_to_int(compression_level),
+        {sexp_to_int(typecheck_element_limit),
+         sexp_to_int(typecheck_depth_limit),
+         sexp_to_bool(typecheck_sampling),
+         sexp_to_int(typecheck_saturation_threshold)},
+        sexp_to_int(na_scan_thread_count),
+        sexp_to_int(na_scan_length_threshold),
+        sexp_to_string_vector(preload_type_declarations),
+        sexp_to_int(preload_thread_count),
+        sexp_to_bool(capture_value_shapes),
+        sexp_to_bool(infer_signatures),
+        sexp_to_bool(profile_parameters),
+        sexp_to_string_vector(aggregate_tables),
+        sexp_to_aggregate_keys(aggregate_keys),
+        sexp_to_int(aggregate_checkpoint_interval),
+        sexp_to_bool(measure_probe_latency),
+        clock_mode_from_string(sexp_to_string(execution_clock)));
 
     /* calloc initializes the memory to zero. This ensures that probes not
        attached will be NULL. Replacing calloc with malloc will cause
@@ -79,4 +127,10 @@ SEXP destroy_dyntracer(SEXP dyntracer_sexp) {
     return dyntracer_destroy_sexp(dyntracer_sexp, destroy_promise_dyntracer);
 }
 
+SEXP reload_type_declarations(SEXP dyntracer_sexp) {
+    dyntracer_t* dyntracer = dyntracer_from_sexp(dyntracer_sexp);
+    static_cast<TracerState*>(dyntracer->state)->reload_type_declarations();
+    return R_NilValue;
+}
+
 } // extern "C"
@@ -17,10 +17,28 @@ SEXP create_dyntracer(SEXP type_declaration_dirpath,
                       SEXP verbose,
                       SEXP truncate,
                       SEXP binary,
-                      SEXP compression_level);
+                      SEXP compression_level,
+                      SEXP typecheck_element_limit,
+                      SEXP typecheck_depth_limit,
+                      SEXP typecheck_sampling,
+                      SEXP typecheck_saturation_threshold,
+                      SEXP na_scan_thread_count,
+                      SEXP na_scan_length_threshold,
+                      SEXP preload_type_declarations,
+                      SEXP preload_thread_count,
+                      SEXP capture_value_shapes,
+                      SEXP infer_signatures,
+                      SEXP profile_parameters,
+                      SEXP aggregate_tables,
+                      SEXP aggregate_keys,
+                      SEXP aggregate_checkpoint_interval,
+                      SEXP measure_probe_latency,
+                      SEXP execution_clock);
 
 SEXP destroy_dyntracer(SEXP dyntracer_sexp);
 
+SEXP reload_type_declarations(SEXP dyntracer_sexp);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,5 +1,9 @@
 #include "typechecker.h"
 
+#include "nascan.h"
+#include "sexptypes.h"
+#include "utilities.h"
+
 using tastr::ast::AScalarTypeNode;
 using tastr::ast::GroupTypeNode;
 using tastr::ast::ListTypeNode;
@@ -37,7 +41,84 @@ std::string to_string(const Typecheck& typecheck) {
     case Typecheck::NotAvailable:
         return "NotAvailable";
         break;
+    case Typecheck::Partial:
+        return "Partial";
+        break;
+    case Typecheck::Saturated:
+        return "Saturated";
+        break;
+    }
+}
+
+static typecheck_budget_t typecheck_budget = {-1, -1, false, 0};
+
+/* xorshift state for sampling list elements, reseeded with the budget so
+   that traces are reproducible. */
+static std::uint64_t typecheck_sampling_state = 88172645463325252ULL;
+
+void set_typecheck_budget(const typecheck_budget_t& budget) {
+    typecheck_budget = budget;
+    typecheck_sampling_state = 88172645463325252ULL;
+}
+
+const typecheck_budget_t& get_typecheck_budget() {
+    return typecheck_budget;
+}
+
+static bool value_shape_capture = false;
+
+void set_value_shape_capture(bool capture) {
+    value_shape_capture = capture;
+}
+
+bool is_value_shape_capture_enabled() {
+    return value_shape_capture;
+}
+
+static bool parameter_profiling = false;
+
+void set_parameter_profiling(bool profiling) {
+    parameter_profiling = profiling;
+}
+
+bool is_parameter_profiling_enabled() {
+    return parameter_profiling;
+}
+
+bool is_within_depth_budget(int depth) {
+    return typecheck_budget.depth_limit < 0 ||
+           depth < typecheck_budget.depth_limit;
+}
+
+R_xlen_t get_budgeted_element_count(R_xlen_t element_count) {
+    if (typecheck_budget.element_limit < 0 ||
+        element_count <= typecheck_budget.element_limit) {
+        return element_count;
     }
+    return typecheck_budget.element_limit;
+}
+
+R_xlen_t get_budgeted_element_index(R_xlen_t index, R_xlen_t element_count) {
+    if (!typecheck_budget.sampling ||
+        get_budgeted_element_count(element_count) == element_count) {
+        return index;
+    }
+
+    typecheck_sampling_state ^= typecheck_sampling_state << 13;
+    typecheck_sampling_state ^= typecheck_sampling_state >> 7;
+    typecheck_sampling_state ^= typecheck_sampling_state << 17;
+
+    return typecheck_sampling_state % element_count;
+}
+
+Typecheck combine_alternatives(Typecheck first, Typecheck second) {
+    if (first == Typecheck::Match || second == Typecheck::Match) {
+        return Typecheck::Match;
+    }
+    if (first == Typecheck::Partial || second == Typecheck::Partial) {
+        return Typecheck::Partial;
+    }
+    return second;
 }
 
 template <typename TypeChecker>
@@ -56,12 +137,11 @@ Typecheck satisfies_scalar(const ScalarTypeNode& type,
     }
 }
 
-template <typename TypeChecker, typename NAChecker>
+template <typename TypeChecker>
 Typecheck satisfies_vector_or_scalar(SEXP value,
                                      const TypeNode& type,
                                      TypeChecker is_scalar_type,
-                                     int length,
-                                     NAChecker is_na) {
+                                     int length) {
     if (!type.is_vector_type_node() && !type.is_scalar_type_node()) {
         return Typecheck::Mismatch;
     }
@@ -82,82 +162,106 @@ Typecheck satisfies_vector_or_scalar(SEXP value,
             na_allowed);
     }
 
-    if (!na_allowed) {
-        for (int i = 0; i < length; ++i) {
-            if (is_na(value, i)) {
-                result = Typecheck::Mismatch;
-                break;
-            }
-        }
+    if (!na_allowed && result == Typecheck::Match && has_na(value)) {
+        result = Typecheck::Mismatch;
     }
 
     return result;
 }
 
-Typecheck satisfies_list(SEXP value, const ListTypeNode& type) {
+Typecheck satisfies_list(SEXP value, const ListTypeNode& type, int depth) {
     TypeNodeSequenceNode& element_types(type.get_element_types());
     int element_count = LENGTH(value);
-    if (element_types.size() != element_count) {
+    if (element_types.size() != static_cast<std::size_t>(element_count)) {
         return Typecheck::Mismatch;
     }
-    for (int i = 0; i < element_count; ++i) {
-        Typecheck result =
-            satisfies(VECTOR_ELT(value, i), *element_types.at(i).get());
+    if (!is_within_depth_budget(depth)) {
+        return element_count == 0 ? Typecheck::Match : Typecheck::Partial;
+    }
 
-        if (result != Typecheck::Match) {
+    int checked_count = get_budgeted_element_count(element_count);
+    Typecheck outcome = checked_count == element_count ? Typecheck::Match
+                                                       : Typecheck::Partial;
+
+    for (int i = 0; i < checked_count; ++i) {
+        int index = get_budgeted_element_index(i, element_count);
+        Typecheck result = satisfies(
+            VECTOR_ELT(value, index), *element_types.at(index).get(), depth + 1);
+
+        if (result == Typecheck::Partial) {
+            outcome = result;
+        } else if (result != Typecheck::Match) {
             return result;
         }
     }
-    return Typecheck::Match;
+    return outcome;
 }
 
-Typecheck satisfies_struct(SEXP value, const StructTypeNode& type) {
+Typecheck satisfies_struct(SEXP value, const StructTypeNode& type, int depth) {
     TagTypePairNodeSequenceNode& element_types(type.get_element_types());
     int element_count = LENGTH(value);
     SEXP names = getAttrib(value, R_NamesSymbol);
     int names_count = LENGTH(names);
 
-    if (element_types.size() != element_count ||
-        element_types.size() != names_count) {
+    if (element_types.size() != static_cast<std::size_t>(element_count) ||
+        element_types.size() != static_cast<std::size_t>(names_count)) {
         return Typecheck::Mismatch;
     }
 
+    /* names are cheap to compare, so they are checked outside the budget */
     for (int i = 0; i < element_count; ++i) {
         TagTypePairNode& node(*element_types.at(i).get());
         std::string name = CHAR(STRING_ELT(names, i));
         if (node.get_identifier().get_name() != name) {
             return Typecheck::Mismatch;
         }
-        Typecheck result = satisfies(VECTOR_ELT(value, i), node.get_type());
+    }
 
-        if (result != Typecheck::Match) {
+    if (!is_within_depth_budget(depth)) {
+        return element_count == 0 ? Typecheck::Match : Typecheck::Partial;
+    }
+
+    int checked_count = get_budgeted_element_count(element_count);
+    Typecheck outcome = checked_count == element_count ? Typecheck::Match
+                                                       : Typecheck::Partial;
+
+    for (int i = 0; i < checked_count; ++i) {
+        int index = get_budgeted_element_index(i, element_count);
+        TagTypePairNode& node(*element_types.at(index).get());
+        Typecheck result =
+            satisfies(VECTOR_ELT(value, index), node.get_type(), depth + 1);
+
+        if (result == Typecheck::Partial) {
+            outcome = result;
+        } else if (result != Typecheck::Match) {
             return result;
         }
     }
-    return Typecheck::Match;
+    return outcome;
 }
 
-Typecheck satisfies(SEXP value, const TypeNode& type) {
+Typecheck satisfies(SEXP value, const TypeNode& type, int depth) {
     SEXPTYPE sexptype = TYPEOF(value);
 
     if (type.is_union_type_node()) {
         const UnionTypeNode& union_type = tastr::ast::as<UnionTypeNode>(type);
-        Typecheck result = satisfies(value, union_type.get_first_type());
+        Typecheck result = satisfies(value, union_type.get_first_type(), depth);
         if (result == Typecheck::Match) {
             return result;
         }
-        return satisfies(value, union_type.get_second_type());
+        return combine_alternatives(
+            result, satisfies(value, union_type.get_second_type(), depth));
     }
 
     if (type.is_group_type_node()) {
         const GroupTypeNode& group_type = tastr::ast::as<GroupTypeNode>(type);
-        return satisfies(value, group_type.get_inner_type());
+        return satisfies(value, group_type.get_inner_type(), depth);
     }
 
     if (type.is_nullable_type_node() && sexptype != NILSXP) {
         const NullableTypeNode& nullable_type =
             tastr::ast::as<NullableTypeNode>(type);
-        return satisfies(value, nullable_type.get_inner_type());
+        return satisfies(value, nullable_type.get_inner_type(), depth);
     }
 
     Typecheck result;
@@ -180,10 +284,7 @@ Typecheck satisfies(SEXP value, const TypeNode& type) {
                            ? Typecheck::Match
                            : Typecheck::Mismatch;
             },
-            LENGTH(value),
-            [](SEXP vector, int index) -> bool {
-                return LOGICAL_ELT(vector, index) == NA_LOGICAL;
-            });
+            LENGTH(value));
         break;
 
     case INTSXP: /* integer */
@@ -195,10 +296,7 @@ Typecheck satisfies(SEXP value, const TypeNode& type) {
                            ? Typecheck::Match
                            : Typecheck::Mismatch;
             },
-            LENGTH(value),
-            [](SEXP vector, int index) -> bool {
-                return INTEGER_ELT(vector, index) == NA_INTEGER;
-            });
+            LENGTH(value));
         break;
 
     case RAWSXP: /* raw */
@@ -209,11 +307,7 @@ Typecheck satisfies(SEXP value, const TypeNode& type) {
                 return node.is_raw_a_scalar_type_node() ? Typecheck::Match
                                                         : Typecheck::Mismatch;
             },
-            LENGTH(value),
-            [](SEXP vector, int index) -> bool {
-                /* NOTE: no such thing as a raw NA */
-                return false;
-            });
+            LENGTH(value));
         break;
 
     case REALSXP: /* numeric */ /* double */
@@ -225,10 +319,7 @@ Typecheck satisfies(SEXP value, const TypeNode& type) {
                            ? Typecheck::Match
                            : Typecheck::Mismatch;
             },
-            LENGTH(value),
-            [](SEXP vector, int index) -> bool {
-                return ISNAN(REAL_ELT(vector, index));
-            });
+            LENGTH(value));
         break;
 
     case CPLXSXP: /* complex */
@@ -240,11 +331,7 @@ Typecheck satisfies(SEXP value, const TypeNode& type) {
                            ? Typecheck::Match
                            : Typecheck::Mismatch;
             },
-            LENGTH(value),
-            [](SEXP vector, int index) -> bool {
-                Rcomplex v = COMPLEX_ELT(vector, index);
-                return (ISNAN(v.r) || ISNAN(v.i));
-            });
+            LENGTH(value));
         break;
 
     case STRSXP: /* character */
@@ -256,10 +343,7 @@ Typecheck satisfies(SEXP value, const TypeNode& type) {
                            ? Typecheck::Match
                            : Typecheck::Mismatch;
             },
-            LENGTH(value),
-            [](SEXP vector, int index) -> bool {
-                return STRING_ELT(vector, index) == NA_STRING;
-            });
+            LENGTH(value));
         break;
 
     case S4SXP: /* S4 */
@@ -288,11 +372,12 @@ Typecheck satisfies(SEXP value, const TypeNode& type) {
 
     case VECSXP: /* list */
         if (type.is_list_type_node()) {
-            return satisfies_list(value, tastr::ast::as<ListTypeNode>(type));
+            return satisfies_list(
+                value, tastr::ast::as<ListTypeNode>(type), depth);
         }
         if (type.is_struct_type_node()) {
-            return satisfies_struct(value,
-                                    tastr::ast::as<StructTypeNode>(type));
+            return satisfies_struct(
+                value, tastr::ast::as<StructTypeNode>(type), depth);
         }
         return Typecheck::Mismatch;
         break;
@@ -343,5 +428,362 @@ Typecheck satisfies(SEXP value, const TypeNode& type) {
     }
 }
 
+static unsigned long altrep_scan_counts[to_underlying(AltrepScan::COUNT)];
+
+unsigned long get_altrep_scan_count(AltrepScan altrep_scan) {
+    return altrep_scan_counts[to_underlying(altrep_scan)];
+}
+
+void reset_altrep_scan_counts() {
+    for (unsigned long& count: altrep_scan_counts) {
+        count = 0;
+    }
+}
+
+static bool count_altrep_scan(AltrepScan altrep_scan, bool result) {
+    ++altrep_scan_counts[to_underlying(altrep_scan)];
+    return result;
+}
+
+static bool has_na_data(SEXPTYPE sexptype, const void* data, R_xlen_t length) {
+    switch (sexptype) {
+    case LGLSXP:
+    case INTSXP:
+        return has_na_integer(static_cast<const int*>(data), length);
+
+    case REALSXP:
+        return has_na_real(static_cast<const double*>(data), length);
+
+    case CPLXSXP:
+        return has_na_complex(static_cast<const Rcomplex*>(data), length);
+
+    case STRSXP:
+        return has_na_string(static_cast<const SEXP*>(data), length);
+
+    /* NOTE: no such thing as a raw NA */
+    default:
+        return false;
+    }
+}
+
+/* single element check, used at the ends of sorted vectors and for the
+   sampled elements of vectors beyond the typecheck budget */
+static bool is_na_elt(SEXP value, R_xlen_t index) {
+    switch (TYPEOF(value)) {
+    case LGLSXP:
+        return LOGICAL_ELT(value, index) == NA_LOGICAL;
+
+    case INTSXP:
+        return INTEGER_ELT(value, index) == NA_INTEGER;
+
+    case REALSXP:
+        return ISNAN(REAL_ELT(value, index));
+
+    case CPLXSXP: {
+        Rcomplex element = COMPLEX_ELT(value, index);
+        return ISNAN(element.r) || ISNAN(element.i);
+    }
+
+    case STRSXP:
+        return STRING_ELT(value, index) == NA_STRING;
+
+    default:
+        return false;
+    }
+}
+
+static bool has_no_na_hint(SEXP value) {
+    switch (TYPEOF(value)) {
+    case LGLSXP:
+        return LOGICAL_NO_NA(value);
+
+    case INTSXP:
+        return INTEGER_NO_NA(value);
+
+    case REALSXP:
+        return REAL_NO_NA(value);
+
+    case STRSXP:
+        return STRING_NO_NA(value);
+
+    default:
+        return false;
+    }
+}
+
+static int get_sortedness(SEXP value) {
+    switch (TYPEOF(value)) {
+    case LGLSXP:
+        return LOGICAL_IS_SORTED(value);
+
+    case INTSXP:
+        return INTEGER_IS_SORTED(value);
+
+    case REALSXP:
+        return REAL_IS_SORTED(value);
+
+    case STRSXP:
+        return STRING_IS_SORTED(value);
+
+    default:
+        return UNKNOWN_SORTEDNESS;
+    }
+}
+
+/* elements copied out of an ALTREP vector per region */
+static const R_xlen_t ALTREP_REGION_SIZE = 1024;
+
+template <typename T, typename Region, typename Kernel>
+static bool has_na_region(SEXP value,
+                          R_xlen_t length,
+                          Region get_region,
+                          Kernel has_na_kernel) {
+    T buffer[ALTREP_REGION_SIZE];
+
+    for (R_xlen_t index = 0; index < length;) {
+        R_xlen_t count = get_region(value, index, ALTREP_REGION_SIZE, buffer);
+
+        if (count <= 0) {
+            break;
+        }
+
+        if (has_na_kernel(buffer, count)) {
+            return true;
+        }
+
+        index += count;
+    }
+
+    return false;
+}
+
+static bool has_na_altrep(SEXP value) {
+    SEXPTYPE sexptype = TYPEOF(value);
+    R_xlen_t length = XLENGTH(value);
+
+    if (has_no_na_hint(value)) {
+        return count_altrep_scan(AltrepScan::NoNAHint, false);
+    }
+
+    /* sorting places all NAs at one end */
+    int sortedness = get_sortedness(value);
+
+    if (KNOWN_SORTED(sortedness)) {
+        bool result = length != 0 &&
+                      is_na_elt(value,
+                                KNOWN_NA_1ST(sortedness) ? 0 : length - 1);
+        return count_altrep_scan(AltrepScan::SortedHint, result);
+    }
+
+    /* only returns data that already exists */
+    const void* data = DATAPTR_OR_NULL(value);
+
+    if (data != nullptr) {
+        return count_altrep_scan(AltrepScan::DataPointer,
+                                 has_na_data(sexptype, data, length));
+    }
+
+    switch (sexptype) {
+    case LGLSXP:
+        return count_altrep_scan(
+            AltrepScan::RegionScan,
+            has_na_region<int>(
+                value, length, LOGICAL_GET_REGION, has_na_integer));
+
+    case INTSXP:
+        return count_altrep_scan(
+            AltrepScan::RegionScan,
+            has_na_region<int>(
+                value, length, INTEGER_GET_REGION, has_na_integer));
+
+    case REALSXP:
+        return count_altrep_scan(
+            AltrepScan::RegionScan,
+            has_na_region<double>(
+                value, length, REAL_GET_REGION, has_na_real));
+
+    case CPLXSXP:
+        return count_altrep_scan(
+            AltrepScan::RegionScan,
+            has_na_region<Rcomplex>(
+                value, length, COMPLEX_GET_REGION, has_na_complex));
+
+    /* strings have no region access */
+    case STRSXP:
+        for (R_xlen_t i = 0; i < length; ++i) {
+            if (STRING_ELT(value, i) == NA_STRING) {
+                return count_altrep_scan(AltrepScan::ElementScan, true);
+            }
+        }
+        return count_altrep_scan(AltrepScan::ElementScan, false);
+
+    default:
+        return false;
+    }
+}
+
+bool has_na(SEXP value) {
+    if (ALTREP(value)) {
+        return has_na_altrep(value);
+    }
+
+    return has_na_data(TYPEOF(value), DATAPTR(value), XLENGTH(value));
+}
+
+bool has_budgeted_na(SEXP value) {
+    R_xlen_t length = XLENGTH(value);
+    R_xlen_t count = get_budgeted_element_count(length);
+
+    if (count == length) {
+        return has_na(value);
+    }
+
+    if (ALTREP(value) && has_no_na_hint(value)) {
+        return false;
+    }
+
+    if (!typecheck_budget.sampling && !ALTREP(value)) {
+        return has_na_data(TYPEOF(value), DATAPTR(value), count);
+    }
+
+    for (R_xlen_t index = 0; index < count; ++index) {
+        if (is_na_elt(value, get_budgeted_element_index(index, length))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template <typename T>
+static void append_value_shape_key(std::string& key, T value) {
+    key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static value_shape_t compute_exact_value_shape(SEXP value,
+                                               std::uint32_t na_sexptype_mask) {
+    SEXPTYPE sexptype = TYPEOF(value);
+    value_shape_t shape = 1 | (static_cast<value_shape_t>(sexptype) << 1);
+
+    switch (sexptype) {
+    case LGLSXP:
+    case INTSXP:
+    case REALSXP:
+    case CPLXSXP:
+    case STRSXP:
+    case RAWSXP:
+        shape |= static_cast<value_shape_t>(XLENGTH(value) <= 1) << 6;
+        if ((na_sexptype_mask >> sexptype) & 1) {
+            shape |= static_cast<value_shape_t>(has_na(value)) << 7;
+        }
+        break;
+    default:
+        break;
+    }
+
+    return shape;
+}
+
+/* Appends the exact shapes of the elements of lists, lists themselves are
+   their length, followed by their names and their elements. Names are
+   their contents, NA names are marked by a length no name has. Returns
+   false if the list is too deep or too long. */
+static bool append_value_shape_key(std::string& key,
+                                   SEXP value,
+                                   std::uint32_t na_sexptype_mask,
+                                   int depth) {
+    if (TYPEOF(value) != VECSXP) {
+        append_value_shape_key(
+            key, compute_exact_value_shape(value, na_sexptype_mask));
+        return true;
+    }
+
+    R_xlen_t length = XLENGTH(value);
+
+    if (depth >= VALUE_SHAPE_DEPTH || length > VALUE_SHAPE_ELEMENT_LIMIT) {
+        return false;
+    }
+
+    /* exact shapes have bit 0 set */
+    append_value_shape_key<value_shape_t>(key, length << 1);
+
+    SEXP names = getAttrib(value, R_NamesSymbol);
+    append_value_shape_key<std::uint8_t>(key, names != R_NilValue);
+
+    for (R_xlen_t i = 0; names != R_NilValue && i < length; ++i) {
+        SEXP name = STRING_ELT(names, i);
+
+        if (name == NA_STRING) {
+            append_value_shape_key<std::uint32_t>(key, -1);
+        } else {
+            append_value_shape_key<std::uint32_t>(key, LENGTH(name));
+            key.append(CHAR(name), LENGTH(name));
+        }
+    }
+
+    for (R_xlen_t i = 0; i < length; ++i) {
+        if (!append_value_shape_key(
+                key, VECTOR_ELT(value, i), na_sexptype_mask, depth + 1)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+value_shape_t compute_value_shape(SEXP value,
+                                  std::uint32_t na_sexptype_mask,
+                                  std::string& key) {
+    key.clear();
+
+    if (TYPEOF(value) != VECSXP) {
+        return compute_exact_value_shape(value, na_sexptype_mask);
+    }
+
+    if (!append_value_shape_key(key, value, na_sexptype_mask, 0)) {
+        key.clear();
+        return UNDEFINED_VALUE_SHAPE;
+    }
+
+    return std::hash<std::string>{}(key) | (1ULL << 63) | 1;
+}
+
+std::string value_shape_to_string(value_shape_t shape) {
+    if (shape == UNDEFINED_VALUE_SHAPE) {
+        return "undefined";
+    }
+
+    if (!is_exact_value_shape(shape)) {
+        std::stringstream stream;
+        stream << "list " << std::hex << shape;
+        return stream.str();
+    }
+
+    SEXPTYPE sexptype = get_value_shape_sexptype(shape);
+    std::string name = sexptype_to_string(sexptype);
+
+    if (is_sexptype_value_shape(shape)) {
+        return name;
+    }
+
+    switch (sexptype) {
+    case LGLSXP:
+    case INTSXP:
+    case REALSXP:
+    case CPLXSXP:
+    case STRSXP:
+    case RAWSXP:
+        name.append(is_scalar_value_shape(shape) ? " scalar" : " vector");
+        if (has_na_value_shape(shape)) {
+            name.append(" with NA");
+        }
+        break;
+    default:
+        break;
+    }
+
+    return name;
+}
+
 // function_id, call_id, parameter_id, expected, actual, match_fail_index,
 // reason
@@ -1,16 +1,134 @@
 #ifndef TYPETESTERDYNTRACER_TYPECHECKER_H
 #define TYPETESTERDYNTRACER_TYPECHECKER_H
 
+#include "AltrepScan.h"
+#include "constants.h"
 #include "stdlibs.h"
 
 #include <tastr/ast/ast.hpp>
 
-enum class Typecheck { Undefined, Mismatch, Match, NotAvailable };
+/* Saturated marks checks skipped by typecheck saturation, they are counted
+   instead of being reported. */
+enum class Typecheck {
+    Undefined,
+    Mismatch,
+    Match,
+    NotAvailable,
+    Partial,
+    Saturated
+};
 
 std::ostream& operator<<(std::ostream& os, const Typecheck& typecheck);
 
 std::string to_string(const Typecheck& typecheck);
 
-Typecheck satisfies(SEXP value, const tastr::ast::TypeNode& type);
+/* depth is the number of lists value is nested in */
+Typecheck satisfies(SEXP value,
+                    const tastr::ast::TypeNode& type,
+                    int depth = 0);
+
+/* Limits on the elements of list and struct values that are typechecked.
+   Elements are checked for the first element_limit elements of a list, or
+   for element_limit randomly sampled elements if sampling is set, and only
+   for lists nested in fewer than depth_limit lists. Negative limits are
+   unlimited. A check which skips elements and finds no mismatch is
+   Partial. Checks of values of one shape against a parameter saturate
+   after saturation_threshold identical outcomes, a threshold of zero
+   disables saturation. */
+struct typecheck_budget_t {
+    int element_limit;
+    int depth_limit;
+    bool sampling;
+    int saturation_threshold;
+};
+
+void set_typecheck_budget(const typecheck_budget_t& budget);
+
+const typecheck_budget_t& get_typecheck_budget();
+
+bool is_within_depth_budget(int depth);
+
+/* number of elements of a list of length element_count to check */
+R_xlen_t get_budgeted_element_count(R_xlen_t element_count);
+
+/* index of the index-th element to check */
+R_xlen_t get_budgeted_element_index(R_xlen_t index, R_xlen_t element_count);
+
+/* result of a value checked against two alternatives */
+Typecheck combine_alternatives(Typecheck first, Typecheck second);
+
+/* true if an atomic vector contains an NA, raw vectors never do. ALTREP
+   vectors are never materialized, their hints are consulted first and
+   their data is otherwise scanned in regions. */
+bool has_na(SEXP value);
+
+/* true if an NA is found among the elements of an atomic vector the
+   typecheck budget checks, the first element_limit elements or as many
+   sampled ones. Vectors within the budget are scanned whole. NAs beyond
+   the budget are missed, so the result is an estimate for longer
+   vectors. */
+bool has_budgeted_na(SEXP value);
+
+/* The shape of a value determines the outcome of typechecking it against
+   any type whose NA sensitive sexptypes are in na_sexptype_mask. Shapes of
+   values other than lists are exact, they encode the sexptype, whether the
+   length is at most one and, only for sexptypes in na_sexptype_mask,
+   whether the value has an NA, so that other values are never scanned.
+   Shapes of lists hash key, which is set to the lengths, names and element
+   shapes of the list and is compared to tell lists with the same hash
+   apart. Shapes are only computed for lists within VALUE_SHAPE_DEPTH and
+   VALUE_SHAPE_ELEMENT_LIMIT, other lists get UNDEFINED_VALUE_SHAPE. key is
+   empty for values other than lists. */
+value_shape_t compute_value_shape(SEXP value,
+                                  std::uint32_t na_sexptype_mask,
+                                  std::string& key);
+
+inline bool is_exact_value_shape(value_shape_t shape) {
+    return (shape >> 63) == 0;
+}
+
+inline SEXPTYPE get_value_shape_sexptype(value_shape_t shape) {
+    return (shape >> 1) & 31;
+}
+
+inline bool is_scalar_value_shape(value_shape_t shape) {
+    return (shape >> 6) & 1;
+}
+
+inline bool has_na_value_shape(value_shape_t shape) {
+    return (shape >> 7) & 1;
+}
+
+/* the shape of values whose typecheck only depends on their sexptype, it
+   is only used to key typecheck saturation */
+inline value_shape_t get_sexptype_value_shape(SEXPTYPE sexptype) {
+    return 1 | (static_cast<value_shape_t>(sexptype) << 1) | (1 << 8);
+}
+
+inline bool is_sexptype_value_shape(value_shape_t shape) {
+    return (shape >> 8) & 1;
+}
+
+/* the sexptype of exact shapes followed by their length and whether they
+   have an NA, where these are part of the shape. shapes of lists are their
+   hash. */
+std::string value_shape_to_string(value_shape_t shape);
+
+/* when set, the shapes of typechecked values are captured for the
+   value_shapes table and signature inference */
+void set_value_shape_capture(bool capture);
+
+bool is_value_shape_capture_enabled();
+
+/* when set, typechecked values are added to the parameter profiles of
+   their function */
+void set_parameter_profiling(bool profiling);
+
+bool is_parameter_profiling_enabled();
+
+/* number of NA checks of ALTREP vectors answered in each way */
+unsigned long get_altrep_scan_count(AltrepScan altrep_scan);
+
+void reset_altrep_scan_counts();
 
 #endif /* TYPETESTERDYNTRACER_TYPECHECKER_H */
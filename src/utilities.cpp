@@ -49,6 +49,14 @@ std::string sexp_to_string(SEXP value) {
     return std::string(CHAR(STRING_ELT(value, 0)));
 }
 
+std::vector<std::string> sexp_to_string_vector(SEXP value) {
+    std::vector<std::string> strings;
+    for (int i = 0; i < LENGTH(value); ++i) {
+        strings.push_back(CHAR(STRING_ELT(value, i)));
+    }
+    return strings;
+}
+
 const char* get_name(SEXP sexp) {
     const char* s = NULL;
 
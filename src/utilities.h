@@ -31,6 +31,8 @@ int sexp_to_int(SEXP value);
 
 std::string sexp_to_string(SEXP value);
 
+std::vector<std::string> sexp_to_string_vector(SEXP value);
+
 std::string compute_hash(const char* data);
 
 const char* get_name(SEXP sexp);